@@ -25,6 +25,13 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/CommandLine.h"
 #include <cmath>
 
 using namespace llvm;
@@ -36,6 +43,26 @@ using namespace llvm;
 // everything in an anonymous namespace.
 namespace {
 
+// Divisioni per un valore invariante nel loop ma noto solo a run-time: il
+// magic number viene calcolato una volta nel preheader
+static cl::opt<bool> MagicDivOpt(
+    "sr-magic-div",
+    cl::desc("Divisioni per un divisore invariante nel loop con magic number a run-time"),
+    cl::init(true));
+
+// Sotto questo numero di iterazioni il calcolo nel preheader non si ripaga
+static cl::opt<unsigned> MagicDivMinTrips(
+    "sr-magic-div-min-trips",
+    cl::desc("Numero minimo di iterazioni del loop per usare il magic number"),
+    cl::init(4));
+
+// Magic number e shift di un divisore, calcolati nel preheader
+struct Magic {
+  Value *M = nullptr;
+  Value *Sh1 = nullptr; // senza segno: primo shift (0 o 1)
+  Value *Sh2 = nullptr; // senza segno: secondo shift; con segno: shift finale
+  Value *DSign = nullptr; // con segno: 0 o -1 secondo il segno del divisore
+};
 
 // New PM implementation
 struct TestPass: PassInfoMixin<TestPass> {
@@ -129,6 +156,153 @@ struct TestPass: PassInfoMixin<TestPass> {
   }
 
 
+  // Magic number per la divisione senza segno (Granlund-Montgomery, fig. 4.1)
+  // su N bit, con i prodotti e la divisione nel preheader su 2N bit:
+  //   l = ceil(log2 d), m = floor(2^N * (2^l - d) / d) + 1
+  //   sh1 = min(l, 1), sh2 = max(l - 1, 0)
+  // Il divisore nullo viene sostituito con 1: il preheader viene eseguito
+  // anche quando la divisione nel loop non lo sarebbe (per lo stesso motivo
+  // D arriva gia' congelato, vedi runOnLoops).
+  Magic magicUnsigned(IRBuilder<> &B, Value *D)
+  {
+    Type *Ty = D->getType();
+    unsigned N = Ty->getIntegerBitWidth();
+    Type *WideTy = B.getIntNTy(2 * N);
+    Value *DSafe = B.CreateSelect(B.CreateICmpEQ(D, ConstantInt::get(Ty, 0)),
+                                  ConstantInt::get(Ty, 1), D, "div.safe");
+    Value *Clz = B.CreateIntrinsic(Intrinsic::ctlz, {Ty},
+                                   {B.CreateSub(DSafe, ConstantInt::get(Ty, 1)), B.getFalse()});
+    Value *L = B.CreateSub(ConstantInt::get(Ty, N), Clz, "magic.l");
+    Value *DW = B.CreateZExt(DSafe, WideTy);
+    Value *Pow = B.CreateShl(ConstantInt::get(WideTy, 1), B.CreateZExt(L, WideTy));
+    Value *Num = B.CreateShl(B.CreateSub(Pow, DW), N);
+    Magic Mg;
+    Mg.M = B.CreateAdd(B.CreateTrunc(B.CreateUDiv(Num, DW), Ty), ConstantInt::get(Ty, 1), "magic.m");
+    Mg.Sh1 = B.CreateZExt(B.CreateICmpNE(L, ConstantInt::get(Ty, 0)), Ty, "magic.sh1");
+    Mg.Sh2 = B.CreateSub(L, Mg.Sh1, "magic.sh2");
+    return Mg;
+  }
+
+  // Magic number per la divisione con segno (Granlund-Montgomery, fig. 5.2):
+  //   l = max(ceil(log2 |d|), 1), m = 1 + floor(2^(N+l-1) / |d|)
+  // m - 2^N entra in N bit con segno: basta troncare.
+  Magic magicSigned(IRBuilder<> &B, Value *D)
+  {
+    Type *Ty = D->getType();
+    unsigned N = Ty->getIntegerBitWidth();
+    Type *WideTy = B.getIntNTy(2 * N);
+    Value *Zero = ConstantInt::get(Ty, 0);
+    Value *One = ConstantInt::get(Ty, 1);
+    Value *DSafe = B.CreateSelect(B.CreateICmpEQ(D, Zero), One, D, "div.safe");
+    Value *Neg = B.CreateICmpSLT(DSafe, Zero);
+    Value *AbsD = B.CreateSelect(Neg, B.CreateNeg(DSafe), DSafe, "div.abs");
+    Value *Clz = B.CreateIntrinsic(Intrinsic::ctlz, {Ty}, {B.CreateSub(AbsD, One), B.getFalse()});
+    Value *Log = B.CreateSub(ConstantInt::get(Ty, N), Clz);
+    Value *L = B.CreateSelect(B.CreateICmpEQ(Log, Zero), One, Log, "magic.l");
+    Value *Exp = B.CreateAdd(B.CreateZExt(L, WideTy), ConstantInt::get(WideTy, N - 1));
+    Value *Pow = B.CreateShl(ConstantInt::get(WideTy, 1), Exp);
+    Value *Q = B.CreateUDiv(Pow, B.CreateZExt(AbsD, WideTy));
+    Magic Mg;
+    Mg.M = B.CreateTrunc(B.CreateAdd(Q, ConstantInt::get(WideTy, 1)), Ty, "magic.m");
+    Mg.Sh2 = B.CreateSub(L, One, "magic.sh");
+    Mg.DSign = B.CreateSExt(Neg, Ty, "magic.dsign");
+    return Mg;
+  }
+
+  // Parte alta del prodotto su N bit
+  Value *mulHigh(IRBuilder<> &B, Value *X, Value *Y, bool Signed)
+  {
+    Type *Ty = X->getType();
+    unsigned N = Ty->getIntegerBitWidth();
+    Type *WideTy = B.getIntNTy(2 * N);
+    Value *XW = Signed ? B.CreateSExt(X, WideTy) : B.CreateZExt(X, WideTy);
+    Value *YW = Signed ? B.CreateSExt(Y, WideTy) : B.CreateZExt(Y, WideTy);
+    return B.CreateTrunc(B.CreateLShr(B.CreateMul(XW, YW), N), Ty);
+  }
+
+  // Il quoziente n / d con moltiplicazioni e shift
+  Value *magicQuotient(IRBuilder<> &B, Value *Num, const Magic &Mg, bool Signed)
+  {
+    if (!Signed) {
+      // q = (t1 + ((n - t1) >> sh1)) >> sh2, t1 = mulhu(m, n)
+      Value *T1 = mulHigh(B, Mg.M, Num, false);
+      Value *T2 = B.CreateLShr(B.CreateSub(Num, T1), Mg.Sh1);
+      return B.CreateLShr(B.CreateAdd(T1, T2), Mg.Sh2);
+    }
+    // q0 = (n + mulhs(m, n)) >> sh - xsign(n); q = (q0 ^ dsign) - dsign
+    unsigned N = Num->getType()->getIntegerBitWidth();
+    Value *Q0 = B.CreateAdd(Num, mulHigh(B, Mg.M, Num, true));
+    Q0 = B.CreateSub(B.CreateAShr(Q0, Mg.Sh2), B.CreateAShr(Num, N - 1));
+    return B.CreateSub(B.CreateXor(Q0, Mg.DSign), Mg.DSign);
+  }
+
+  // udiv/sdiv/urem/srem per un divisore invariante ma non costante: nel loop
+  // piu' esterno in cui il divisore e' invariante il magic number viene
+  // calcolato una volta nel preheader, e ogni divisione diventa una
+  // moltiplicazione (parte alta) e qualche shift. Il resto e' n - q * d.
+  // I divisori costanti li gestisce gia' il backend.
+  bool runOnLoops(Function &F, LoopInfo &LI, ScalarEvolution &SE)
+  {
+    std::vector<BinaryOperator*> Divisioni;
+    for (BasicBlock &BB : F)
+      for (Instruction &I : BB) {
+        auto *BO = dyn_cast<BinaryOperator>(&I);
+        if (!BO || !BO->getType()->isIntegerTy() || isa<Constant>(BO->getOperand(1)))
+          continue;
+        unsigned Op = BO->getOpcode();
+        if (Op == Instruction::UDiv || Op == Instruction::SDiv ||
+            Op == Instruction::URem || Op == Instruction::SRem)
+          Divisioni.push_back(BO);
+      }
+
+    DenseMap<std::pair<Loop*, Value*>, Magic> MagicU, MagicS;
+    DenseMap<std::pair<Loop*, Value*>, Value*> Congelati;
+    bool Transformed = false;
+    for (BinaryOperator *Div : Divisioni) {
+      Value *D = Div->getOperand(1);
+      // Il loop piu' esterno con preheader in cui il divisore e' invariante
+      Loop *L = nullptr;
+      for (Loop *Cur = LI.getLoopFor(Div->getParent());
+           Cur && Cur->isLoopInvariant(D) && Cur->getLoopPreheader();
+           Cur = Cur->getParentLoop())
+        L = Cur;
+      if (!L)
+        continue;
+      unsigned MaxTrips = SE.getSmallConstantMaxTripCount(L);
+      if (MaxTrips != 0 && MaxTrips < MagicDivMinTrips)
+        continue;
+
+      unsigned Op = Div->getOpcode();
+      bool Signed = Op == Instruction::SDiv || Op == Instruction::SRem;
+      auto &Cache = Signed ? MagicS : MagicU;
+      auto It = Cache.find({L, D});
+      if (It == Cache.end()) {
+        IRBuilder<> PB(L->getLoopPreheader()->getTerminator());
+        // Se la divisione non viene mai eseguita D puo' essere undef o
+        // poison: senza freeze la udiv del preheader sarebbe UB (la select
+        // su una condizione poison e' poison e non la protegge)
+        Value *&DF = Congelati[{L, D}];
+        if (!DF)
+          DF = isGuaranteedNotToBeUndefOrPoison(D, nullptr, L->getLoopPreheader()->getTerminator())
+                   ? D : PB.CreateFreeze(D, D->getName() + ".fr");
+        It = Cache.insert({{L, D}, Signed ? magicSigned(PB, DF) : magicUnsigned(PB, DF)}).first;
+      }
+
+      IRBuilder<> B(Div);
+      Value *Num = Div->getOperand(0);
+      Value *Q = magicQuotient(B, Num, It->second, Signed);
+      Value *R = Q;
+      if (Op == Instruction::URem || Op == Instruction::SRem)
+        R = B.CreateSub(Num, B.CreateMul(Q, D));
+      R->takeName(Div);
+      errs() << "Divisione per invariante con magic number: " << *Div << "\n";
+      Div->replaceAllUsesWith(R);
+      Div->eraseFromParent();
+      Transformed = true;
+    }
+    return Transformed;
+  }
+
 bool runOnFunction(Function &F) {
   bool Transformed = false;
 
@@ -144,9 +318,20 @@ bool runOnFunction(Function &F) {
 
   // Main entry point, takes IR unit to run the pass on (&F) and the
   // corresponding pass manager (to be queried if need be)
-  PreservedAnalyses run(Function &F, FunctionAnalysisManager &) {
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM) {
+    // Prima le divisioni per invarianti nei loop (servono LoopInfo e SCEV
+    // aggiornati), poi le costanti
+    bool LoopTransformed = false;
+    if (MagicDivOpt)
+      LoopTransformed = runOnLoops(F, AM.getResult<LoopAnalysis>(F),
+                                   AM.getResult<ScalarEvolutionAnalysis>(F));
     outs() << runOnFunction(F) << "\n";
-  	return PreservedAnalyses::all();
+    if (!LoopTransformed)
+      return PreservedAnalyses::all();
+    // Solo istruzioni nuove, nessun blocco
+    PreservedAnalyses PA;
+    PA.preserveSet<CFGAnalyses>();
+    return PA;
 }
 
   // Without isRequired returning true, this pass will be skipped for functions
@@ -0,0 +1,85 @@
+; divisione_invariante.ll: divisioni nel loop per un divisore noto solo a
+; run-time.
+; @con_segno e @senza_segno: %d non cambia nel loop. Il magic number viene
+; calcolato una volta nel preheader e nel loop la divisione diventa una
+; moltiplicazione con shift.
+; @divisore_variabile: il divisore cambia ad ogni iterazione, la divisione
+; resta.
+; @poche_iterazioni: il loop gira 2 volte, meno di -sr-magic-div-min-trips
+; (default 4), e il calcolo del magic number non si ripaga.
+define i32 @con_segno(ptr %a, i32 %d) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %p = getelementptr inbounds i32, ptr %a, i64 %i
+  %x = load i32, ptr %p
+  %q = sdiv i32 %x, %d
+  %s.next = add i32 %s, %q
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp ult i64 %i.next, 1000
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %s.next
+}
+
+define i32 @senza_segno(ptr %a, i32 %d) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %p = getelementptr inbounds i32, ptr %a, i64 %i
+  %x = load i32, ptr %p
+  %q = udiv i32 %x, %d
+  %s.next = add i32 %s, %q
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp ult i64 %i.next, 1000
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %s.next
+}
+
+define i32 @divisore_variabile(ptr %a) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %p = getelementptr inbounds i32, ptr %a, i64 %i
+  %x = load i32, ptr %p
+  %i.next = add nuw nsw i64 %i, 1
+  %d = trunc i64 %i.next to i32
+  %q = udiv i32 %x, %d
+  %s.next = add i32 %s, %q
+  %c = icmp ult i64 %i.next, 1000
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %s.next
+}
+
+define i32 @poche_iterazioni(ptr %a, i32 %d) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %p = getelementptr inbounds i32, ptr %a, i64 %i
+  %x = load i32, ptr %p
+  %q = sdiv i32 %x, %d
+  %s.next = add i32 %s, %q
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp ult i64 %i.next, 2
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %s.next
+}
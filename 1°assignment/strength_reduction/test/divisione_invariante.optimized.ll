@@ -0,0 +1,139 @@
+; ModuleID = '../test/divisione_invariante.ll'
+source_filename = "../test/divisione_invariante.ll"
+
+define i32 @con_segno(ptr %a, i32 %d) {
+entry:
+  %d.fr = freeze i32 %d
+  %0 = icmp eq i32 %d.fr, 0
+  %div.safe = select i1 %0, i32 1, i32 %d.fr
+  %1 = icmp slt i32 %div.safe, 0
+  %2 = sub i32 0, %div.safe
+  %div.abs = select i1 %1, i32 %2, i32 %div.safe
+  %3 = sub i32 %div.abs, 1
+  %4 = call i32 @llvm.ctlz.i32(i32 %3, i1 false)
+  %5 = sub i32 32, %4
+  %6 = icmp eq i32 %5, 0
+  %magic.l = select i1 %6, i32 1, i32 %5
+  %7 = zext i32 %magic.l to i64
+  %8 = add i64 %7, 31
+  %9 = shl i64 1, %8
+  %10 = zext i32 %div.abs to i64
+  %11 = udiv i64 %9, %10
+  %12 = add i64 %11, 1
+  %magic.m = trunc i64 %12 to i32
+  %magic.sh = sub i32 %magic.l, 1
+  %magic.dsign = sext i1 %1 to i32
+  br label %loop
+
+loop:                                             ; preds = %loop, %entry
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %p = getelementptr inbounds i32, ptr %a, i64 %i
+  %x = load i32, ptr %p, align 4
+  %13 = sext i32 %magic.m to i64
+  %14 = sext i32 %x to i64
+  %15 = mul i64 %13, %14
+  %16 = lshr i64 %15, 32
+  %17 = trunc i64 %16 to i32
+  %18 = add i32 %x, %17
+  %19 = ashr i32 %x, 31
+  %20 = ashr i32 %18, %magic.sh
+  %21 = sub i32 %20, %19
+  %22 = xor i32 %21, %magic.dsign
+  %q = sub i32 %22, %magic.dsign
+  %s.next = add i32 %s, %q
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp ult i64 %i.next, 1000
+  br i1 %c, label %loop, label %exit
+
+exit:                                             ; preds = %loop
+  ret i32 %s.next
+}
+
+define i32 @senza_segno(ptr %a, i32 %d) {
+entry:
+  %d.fr = freeze i32 %d
+  %0 = icmp eq i32 %d.fr, 0
+  %div.safe = select i1 %0, i32 1, i32 %d.fr
+  %1 = sub i32 %div.safe, 1
+  %2 = call i32 @llvm.ctlz.i32(i32 %1, i1 false)
+  %magic.l = sub i32 32, %2
+  %3 = zext i32 %div.safe to i64
+  %4 = zext i32 %magic.l to i64
+  %5 = shl i64 1, %4
+  %6 = sub i64 %5, %3
+  %7 = shl i64 %6, 32
+  %8 = udiv i64 %7, %3
+  %9 = trunc i64 %8 to i32
+  %magic.m = add i32 %9, 1
+  %10 = icmp ne i32 %magic.l, 0
+  %magic.sh1 = zext i1 %10 to i32
+  %magic.sh2 = sub i32 %magic.l, %magic.sh1
+  br label %loop
+
+loop:                                             ; preds = %loop, %entry
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %p = getelementptr inbounds i32, ptr %a, i64 %i
+  %x = load i32, ptr %p, align 4
+  %11 = zext i32 %magic.m to i64
+  %12 = zext i32 %x to i64
+  %13 = mul i64 %11, %12
+  %14 = lshr i64 %13, 32
+  %15 = trunc i64 %14 to i32
+  %16 = sub i32 %x, %15
+  %17 = lshr i32 %16, %magic.sh1
+  %18 = add i32 %15, %17
+  %q = lshr i32 %18, %magic.sh2
+  %s.next = add i32 %s, %q
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp ult i64 %i.next, 1000
+  br i1 %c, label %loop, label %exit
+
+exit:                                             ; preds = %loop
+  ret i32 %s.next
+}
+
+define i32 @divisore_variabile(ptr %a) {
+entry:
+  br label %loop
+
+loop:                                             ; preds = %loop, %entry
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %p = getelementptr inbounds i32, ptr %a, i64 %i
+  %x = load i32, ptr %p, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %d = trunc i64 %i.next to i32
+  %q = udiv i32 %x, %d
+  %s.next = add i32 %s, %q
+  %c = icmp ult i64 %i.next, 1000
+  br i1 %c, label %loop, label %exit
+
+exit:                                             ; preds = %loop
+  ret i32 %s.next
+}
+
+define i32 @poche_iterazioni(ptr %a, i32 %d) {
+entry:
+  br label %loop
+
+loop:                                             ; preds = %loop, %entry
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %p = getelementptr inbounds i32, ptr %a, i64 %i
+  %x = load i32, ptr %p, align 4
+  %q = sdiv i32 %x, %d
+  %s.next = add i32 %s, %q
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp ult i64 %i.next, 2
+  br i1 %c, label %loop, label %exit
+
+exit:                                             ; preds = %loop
+  ret i32 %s.next
+}
+
+; Function Attrs: nofree nosync nounwind readnone speculatable willreturn
+declare i32 @llvm.ctlz.i32(i32, i1 immarg) #0
+
+attributes #0 = { nofree nosync nounwind readnone speculatable willreturn }
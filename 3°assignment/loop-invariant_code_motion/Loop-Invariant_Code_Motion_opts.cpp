@@ -12,6 +12,9 @@
 //    New PM
 //      opt -load-pass-plugin=<path-to>libTestPass.so -passes="test-pass" `\`
 //        -disable-output <input-llvm-file>
+//    La LICM e' un loop pass: da sola, o dentro una pipeline di loop con
+//    MemorySSA insieme ad altri loop pass:
+//      -passes="loop-mssa(loop-invariant_code_motion_opts,...)"
 
 //
 //
@@ -21,22 +24,61 @@
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/Debug.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/CFG.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
+#include "llvm/Transforms/Utils/SSAUpdater.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Analysis/MemorySSAUpdater.h"
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/CFG.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+#include "llvm/Transforms/Utils/LoopSimplify.h"
+#include "llvm/Transforms/Utils/LCSSA.h"
+#include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Scalar/LoopPassManager.h"
 #include <cmath>
+#include <memory>
+#include <functional>
 #include <vector>
 #include <map>
 #include <set>
 
 using namespace llvm;
 
+#define DEBUG_TYPE "loop-invariant_code_motion_opts"
+
 //-----------------------------------------------------------------------------
 // TestPass implementation
 //-----------------------------------------------------------------------------
@@ -44,171 +86,1668 @@ using namespace llvm;
 // everything in an anonymous namespace.
 namespace {
 
+// Come calcolare le reaching definitions
+enum class RDMode { Auto, SSA, Dense };
 
-// New PM implementation
-struct TestPass: PassInfoMixin<TestPass> {
+static cl::opt<RDMode> RDModeOpt(
+    "licm-rd", cl::desc("Reaching definitions per la LICM"),
+    cl::init(RDMode::Auto),
+    cl::values(clEnumValN(RDMode::Auto, "auto",
+                          "dominanza se l'IR e' in forma SSA, altrimenti dense"),
+               clEnumValN(RDMode::SSA, "ssa", "solo dominanza (forma SSA)"),
+               clEnumValN(RDMode::Dense, "dense",
+                          "solver a bit-vector con kill per nome")));
 
-  std::map<BasicBlock*,std::pair<std::set<Instruction*>,std::set<Instruction*>>> getReachingDefinitions(Function &F)
-  {
-    std::map<BasicBlock*,std::pair<std::set<Instruction*>,std::set<Instruction*>>> rd;
-    unsigned int numInst = F.getInstructionCount();
-    std::set<Instruction*> in, out;
-    std::pair<std::set<Instruction*>,std::set<Instruction*>> p(in,out);
-    std::vector<BasicBlock*> changedNodes;
+// Hoisting dei load e promozione a registro tramite MemorySSA e alias analysis.
+// Se disattivato, le istruzioni che accedono alla memoria restano nel loop.
+static cl::opt<bool> MemoryOpt(
+    "licm-memory",
+    cl::desc("LICM consapevole della memoria (load invarianti e promozione a registro)"),
+    cl::init(true));
+
+// Sinking nelle uscite delle istruzioni usate solo fuori dal loop
+static cl::opt<bool> SinkOpt(
+    "licm-sink", cl::desc("Sposta nelle uscite i valori usati solo dopo il loop"),
+    cl::init(true));
+
+// Hoisting speculativo: un'istruzione che non domina le uscite puo' essere
+// spostata lo stesso se eseguirla quando il loop non l'avrebbe fatto e' sicuro
+// (niente trap, niente effetti collaterali) e costa poco
+static cl::opt<bool> SpeculateOpt(
+    "licm-speculate",
+    cl::desc("Sposta anche istruzioni sicure ed economiche che non dominano le uscite"),
+    cl::init(false));
+
+static cl::opt<unsigned> SpeculationThreshold(
+    "licm-speculation-threshold",
+    cl::desc("Costo massimo (TTI, size+latency) di un'istruzione speculata"),
+    cl::init(2));
+
+// Guardia per i loop che potrebbero non eseguire mai il corpo: permette di
+// spostare istruzioni che possono andare in trap (sdiv, chiamate) se vengono
+// eseguite ad ogni iterazione
+static cl::opt<bool> GuardOpt(
+    "licm-guard",
+    cl::desc("Aggiunge una guardia sul trip count nullo per spostare istruzioni non speculabili"),
+    cl::init(false));
+
+// Versioning dei loop con controlli di alias a runtime: una copia del loop
+// in cui i puntatori sono separati (e la LICM puo' spostare load e store) e
+// l'originale per quando gli intervalli di indirizzi si sovrappongono
+static cl::opt<bool> VersioningOpt(
+    "licm-versioning",
+    cl::desc("Versiona i loop con controlli di alias a runtime prima della LICM"),
+    cl::init(true));
+
+static cl::opt<unsigned> VersioningMaxChecks(
+    "licm-versioning-max-checks",
+    cl::desc("Numero massimo di coppie di intervalli controllate a runtime"),
+    cl::init(8));
+
+// Unswitching dei branch su condizioni invarianti: una copia del loop per
+// ciascun valore della condizione, scelta una volta prima del loop. Il budget
+// limita le istruzioni duplicate in ogni funzione
+static cl::opt<bool> UnswitchOpt(
+    "licm-unswitch",
+    cl::desc("Duplica i loop per i branch su condizioni loop-invariant"),
+    cl::init(true));
+
+static cl::opt<unsigned> UnswitchBudget(
+    "licm-unswitch-budget",
+    cl::desc("Numero massimo di istruzioni duplicate dall'unswitching per funzione"),
+    cl::init(200));
+
+// Rotazione dei loop con il test nell'header (while) in forma do-while con
+// guardia: il corpo domina l'uscita e molte piu' istruzioni si possono spostare
+static cl::opt<bool> RotateOpt(
+    "licm-rotate",
+    cl::desc("Ruota i loop con il test nell'header prima della LICM"),
+    cl::init(true));
+
+static cl::opt<unsigned> RotateMaxHeader(
+    "licm-rotate-max-header",
+    cl::desc("Numero massimo di istruzioni dell'header duplicate dalla rotazione"),
+    cl::init(8));
 
-    //Initialize
+// Riassociazione delle catene associative e commutative prima della LICM, per
+// raggruppare le parti invarianti: (a + i) + b -> (a + b) + i
+static cl::opt<bool> ReassociateOpt(
+    "licm-reassociate",
+    cl::desc("Riassocia le catene di operazioni per esporre sottoespressioni invarianti"),
+    cl::init(true));
+
+// Costanti costose (immediati a 64 bit, indirizzi GEP costanti) usate nel
+// loop: il backend le ricostruisce ad ogni iterazione, meglio una volta sola
+// nel preheader
+static cl::opt<bool> ConstHoistOpt(
+    "licm-const-hoist",
+    cl::desc("Materializza nel preheader le costanti costose secondo il TTI"),
+    cl::init(true));
+
+// Budget di registri: un valore spostato nel preheader resta vivo per tutto
+// il loop; oltre il numero di registri della classe il corpo inizia a fare
+// spill, quindi le istruzioni meno costose restano nel loop
+static cl::opt<bool> RegPressureOpt(
+    "licm-reg-pressure",
+    cl::desc("Limita lo hoisting ai registri liberi attraverso il loop (TTI)"),
+    cl::init(true));
+
+// Reaching definitions con bit-vector densi.
+// Ogni definizione (istruzione binaria) viene numerata una sola volta; gen, kill,
+// in e out di ogni blocco sono BitVector impaccati a parole, quindi unione e
+// differenza diventano cicli sulle parole che il compilatore puo' vettorizzare.
+// La semantica e' quella della versione a std::set: una definizione viene
+// uccisa da qualunque istruzione del blocco con lo stesso nome.
+//
+// In forma SSA ogni valore ha un'unica definizione, che raggiunge esattamente
+// i blocchi che domina: in quel caso (SSA = true) non si calcola niente e
+// reachesIn interroga direttamente il dominator tree.
+struct ReachingDefinitions {
+  bool SSA = false;
+  const DominatorTree *DT = nullptr;
+
+  std::vector<Instruction*> Defs;                //indice -> definizione
+  DenseMap<const Instruction*, unsigned> DefIndex; //definizione -> indice
+  DenseMap<const BasicBlock*, unsigned> BlockIndex;
+  std::vector<BitVector> Gen, Kill, In, Out;
+  unsigned Iterations = 0; //passate sulla worklist fino al punto fisso
+  unsigned Visits = 0;     //blocchi visitati in totale
+
+  void compute(Function &F)
+  {
+    //Numero i blocchi in reverse post-order (quelli irraggiungibili in coda),
+    //cosi' l'indice di un blocco e' anche la sua posizione nella visita
+    std::vector<BasicBlock*> Blocks;
+    for (BasicBlock *bb : ReversePostOrderTraversal<Function*>(&F))
+    {
+      BlockIndex[bb] = Blocks.size();
+      Blocks.push_back(bb);
+    }
     for (BasicBlock &bb : F)
     {
-      rd[&bb]=p;
-      changedNodes.push_back(&bb);
+      if (BlockIndex.insert({&bb, Blocks.size()}).second)
+        Blocks.push_back(&bb);
     }
 
-    // Condizione al contorno: out[entry] = ∅
-    BasicBlock *entry = &F.getEntryBlock();
-    rd[entry].second.clear(); // out[entry] = ∅
-
-    //Iterate
-    while(!changedNodes.empty())
+    //Numero le definizioni
+    StringMap<SmallVector<unsigned, 1>> DefsByName;
+    for (BasicBlock *bb : Blocks)
     {
-      BasicBlock &bi = *(changedNodes.front());
-      changedNodes.erase(changedNodes.begin()); //FIFO
-
-      std::set<Instruction*> ini; //in[i]
-      //Scorro i predecessori
-      for (BasicBlock *pred :  predecessors(&bi)) 
+      for (Instruction &inst : *bb)
       {
-        std::set outp = (rd.at(pred)).second; //out[p]
-        ini.insert(outp.begin(), outp.end()); //in[i] = U out[p]
+        if (inst.isBinaryOp())
+        {
+          DefIndex[&inst] = Defs.size();
+          DefsByName[inst.getName()].push_back(Defs.size());
+          Defs.push_back(&inst);
+        }
       }
-      rd[&bi].first = ini;
+    }
+
+    unsigned NumBlocks = Blocks.size();
+    unsigned NumDefs = Defs.size();
+    Gen.assign(NumBlocks, BitVector(NumDefs));
+    Kill.assign(NumBlocks, BitVector(NumDefs));
+    In.assign(NumBlocks, BitVector(NumDefs));
+    Out.assign(NumBlocks, BitVector(NumDefs)); // out[i] = ∅ (anche per l'entry)
 
-      //Genero gen[i] e kill[i]
-      std::set<Instruction*> geni, killi;
-      for (Instruction &inst : bi)
+    //gen[i] e kill[i] non dipendono da in[i]: li calcolo una volta sola
+    for (BasicBlock &bb : F)
+    {
+      unsigned i = BlockIndex[&bb];
+      for (Instruction &inst : bb)
       {
         if (inst.isBinaryOp())
+          Gen[i].set(DefIndex[&inst]);
+        auto It = DefsByName.find(inst.getName());
+        if (It != DefsByName.end())
+          for (unsigned d : It->second)
+            Kill[i].set(d);
+      }
+    }
+
+    //Worklist: bitset di appartenenza indicizzato per posizione RPO. Ogni
+    //passata scorre i blocchi marcati in ordine crescente; un successore in
+    //avanti viene visitato nella stessa passata, uno raggiunto da un back-edge
+    //in quella successiva. Servono circa (profondita' dei loop + 2) passate.
+    BitVector changedNodes(NumBlocks, true);
+    BitVector outi(NumDefs);
+    Iterations = 0;
+    Visits = 0;
+    while (changedNodes.any())
+    {
+      Iterations++;
+      for (int i = changedNodes.find_first(); i != -1; i = changedNodes.find_next(i))
+      {
+        changedNodes.reset(i);
+        Visits++;
+
+        //in[i] = U out[p]
+        In[i].reset();
+        for (BasicBlock *pred : predecessors(Blocks[i]))
+          In[i] |= Out[BlockIndex[pred]];
+
+        //out[i] = gen[i] U (in[i] - kill[i])
+        outi = In[i];
+        outi.reset(Kill[i]);
+        outi |= Gen[i];
+
+        if (outi != Out[i])
         {
-          geni.insert(&inst);
+          Out[i] = outi;
+          for (BasicBlock *succ : successors(Blocks[i]))
+            changedNodes.set(BlockIndex[succ]);
         }
-        for (Instruction *inInst : ini) {
-          if (inInst->getName() == inst.getName()) 
-          {
-            killi.insert(inInst);
-          }
+      }
+    }
+  }
+
+  void computeSSA(const DominatorTree &Tree)
+  {
+    SSA = true;
+    DT = &Tree;
+  }
+
+  //Def appartiene a in[BB]?
+  bool reachesIn(const BasicBlock *BB, const Instruction *Def) const
+  {
+    if (SSA)
+      return DT->dominates(Def->getParent(), BB);
+    auto D = DefIndex.find(Def);
+    auto B = BlockIndex.find(BB);
+    //Blocchi creati dopo il calcolo (guardie): nessuna informazione
+    if (D == DefIndex.end() || B == BlockIndex.end())
+      return false;
+    return In[B->second].test(D->second);
+  }
+
+  // In forma SSA il risultato dipende solo dal dominator tree; le reaching
+  // definitions dense restano valide finche' nessuno modifica la funzione
+  bool invalidate(Function &F, const PreservedAnalyses &PA,
+                  FunctionAnalysisManager::Invalidator &Inv);
+};
+
+// L'IR e' in forma SSA se le variabili non vivono piu' in alloca
+// promuovibili (cioe' mem2reg e' gia' stato eseguito)
+bool isSSAForm(Function &F)
+{
+  for (Instruction &inst : F.getEntryBlock())
+    if (AllocaInst *AI = dyn_cast<AllocaInst>(&inst))
+      if (isAllocaPromotable(AI))
+        return false;
+  return true;
+}
+
+// Reaching definitions di F secondo -licm-rd
+ReachingDefinitions getReachingDefinitions(Function &F, const DominatorTree &DT)
+{
+  ReachingDefinitions RD;
+  if (RDModeOpt == RDMode::SSA || (RDModeOpt == RDMode::Auto && isSSAForm(F)))
+    RD.computeSSA(DT);
+  else
+    RD.compute(F);
+  LLVM_DEBUG({
+    if (RD.SSA)
+      dbgs() << "Reaching definitions: forma SSA, uso la dominanza\n";
+    else
+      dbgs() << "Reaching definitions: punto fisso in " << RD.Iterations << " passate ("
+             << RD.Visits << " visite su " << RD.BlockIndex.size() << " blocchi)\n";
+  });
+  return RD;
+}
+
+// Reaching definitions come analisi del FunctionAnalysisManager: il risultato
+// viene messo in cache e condiviso per riferimento tra i pass della pipeline.
+struct ReachingDefinitionsAnalysis : AnalysisInfoMixin<ReachingDefinitionsAnalysis> {
+  using Result = ReachingDefinitions;
+
+  Result run(Function &F, FunctionAnalysisManager &AM)
+  {
+    return getReachingDefinitions(F, AM.getResult<DominatorTreeAnalysis>(F));
+  }
+
+private:
+  friend AnalysisInfoMixin<ReachingDefinitionsAnalysis>;
+  static AnalysisKey Key;
+};
+
+AnalysisKey ReachingDefinitionsAnalysis::Key;
+
+bool ReachingDefinitions::invalidate(Function &F, const PreservedAnalyses &PA,
+                                     FunctionAnalysisManager::Invalidator &Inv)
+{
+  if (SSA)
+    return Inv.invalidate<DominatorTreeAnalysis>(F, PA);
+  auto PAC = PA.getChecker<ReachingDefinitionsAnalysis>();
+  return !PAC.preserved() && !PAC.preservedSet<AllAnalysesOn<Function>>();
+}
+
+// Effetti di una funzione (o di una chiamata): readnone, readonly,
+// willreturn, nounwind
+struct EffettiFunzione {
+  bool ReadNone = false;
+  bool ReadOnly = false;
+  bool WillReturn = false;
+  bool NoUnwind = false;
+
+  bool operator==(const EffettiFunzione &O) const
+  {
+    return ReadNone == O.ReadNone && ReadOnly == O.ReadOnly &&
+           WillReturn == O.WillReturn && NoUnwind == O.NoUnwind;
+  }
+  bool operator!=(const EffettiFunzione &O) const { return !(*this == O); }
+};
+
+// Funzioni pure del modulo: attributi readnone/readonly/willreturn/nounwind
+// dedotti dal corpo delle funzioni definite (con definizione esatta, non
+// rimpiazzabile al link). Gli accessi alle alloca della funzione stessa non
+// contano. Memoria e nounwind si deducono in modo ottimista (tutte pure,
+// poi si toglie finche' non cambia piu' niente), che va bene anche con la
+// ricorsione; willreturn in modo pessimista, perche' una ricorsione o un
+// ciclo potrebbero non terminare: serve un CFG aciclico e solo chiamate a
+// funzioni gia' dimostrate willreturn.
+struct PureFunctions {
+  DenseMap<const Function*, EffettiFunzione> Effetti;
+  // Il risultato vive in cache finche' non viene invalidato esplicitamente:
+  // una funzione cancellata puo' lasciare il suo indirizzo a una nuova. Una
+  // voce di Effetti vale solo se la funzione a cui si riferisce esiste ancora.
+  DenseMap<const Function*, WeakVH> Funzioni;
+
+  // Effetti di una chiamata: attributi dichiarati piu' quelli dedotti
+  EffettiFunzione get(const CallBase *Call) const
+  {
+    EffettiFunzione E;
+    E.ReadNone = Call->doesNotAccessMemory();
+    E.ReadOnly = Call->onlyReadsMemory();
+    E.WillReturn = Call->hasFnAttr(Attribute::WillReturn);
+    E.NoUnwind = Call->doesNotThrow();
+    if (const Function *Callee = Call->getCalledFunction()) {
+      auto It = Effetti.find(Callee);
+      if (It != Effetti.end() && Funzioni.lookup(Callee) == Callee) {
+        E.ReadNone |= It->second.ReadNone;
+        E.ReadOnly |= It->second.ReadOnly;
+        E.WillReturn |= It->second.WillReturn;
+        E.NoUnwind |= It->second.NoUnwind;
+      }
+    }
+    return E;
+  }
+
+  // Effetti del corpo di F secondo le deduzioni correnti
+  EffettiFunzione scan(Function &F) const
+  {
+    EffettiFunzione E;
+    E.ReadNone = E.ReadOnly = E.NoUnwind = true;
+    SmallVector<std::pair<const BasicBlock*, const BasicBlock*>, 4> BackEdges;
+    FindFunctionBackedges(F, BackEdges);
+    E.WillReturn = BackEdges.empty();
+    for (Instruction &I : instructions(F)) {
+      if (I.isLifetimeStartOrEnd())
+        continue;
+      if (CallBase *Call = dyn_cast<CallBase>(&I)) {
+        EffettiFunzione C = get(Call);
+        E.ReadNone &= C.ReadNone;
+        E.ReadOnly &= C.ReadOnly || C.ReadNone;
+        E.WillReturn &= C.WillReturn;
+        E.NoUnwind &= C.NoUnwind;
+        continue;
+      }
+      if (I.mayThrow())
+        E.NoUnwind = false;
+      Value *Ptr = getLoadStorePointerOperand(&I);
+      bool Locale = Ptr && (isa<LoadInst>(I) ? cast<LoadInst>(I).isSimple()
+                                               : cast<StoreInst>(I).isSimple()) &&
+                    isa<AllocaInst>(getUnderlyingObject(Ptr));
+      if (Locale)
+        continue;
+      if (I.mayWriteToMemory())
+        E.ReadNone = E.ReadOnly = false;
+      else if (I.mayReadFromMemory())
+        E.ReadNone = false;
+    }
+    if (E.ReadNone)
+      E.ReadOnly = true;
+    return E;
+  }
+
+  void compute(Module &M)
+  {
+    SmallVector<Function*, 16> Definite;
+    for (Function &F : M)
+      if (!F.isDeclaration() && F.hasExactDefinition()) {
+        Definite.push_back(&F);
+        Funzioni[&F] = &F;
+        EffettiFunzione &E = Effetti[&F];
+        E.ReadNone = E.ReadOnly = E.NoUnwind = true;
+      }
+
+    bool Changed = true;
+    while (Changed) {
+      Changed = false;
+      for (Function *F : Definite) {
+        EffettiFunzione Vecchi = Effetti[F];
+        EffettiFunzione Nuovi = scan(*F);
+        Nuovi.ReadNone &= Vecchi.ReadNone;
+        Nuovi.ReadOnly &= Vecchi.ReadOnly;
+        Nuovi.NoUnwind &= Vecchi.NoUnwind;
+        Nuovi.WillReturn |= Vecchi.WillReturn;
+        if (Nuovi != Vecchi) {
+          Effetti[F] = Nuovi;
+          Changed = true;
         }
       }
+    }
+
+    for (Function *F : Definite) {
+      const EffettiFunzione &E = Effetti[F];
+      LLVM_DEBUG(dbgs() << "Funzione " << F->getName() << ":"
+                        << (E.ReadNone ? " readnone" : E.ReadOnly ? " readonly" : "")
+                        << (E.WillReturn ? " willreturn" : "")
+                        << (E.NoUnwind ? " nounwind" : "") << "\n");
+    }
+  }
+
+  // Le trasformazioni di questo plugin non aggiungono effetti alle funzioni:
+  // il risultato resta valido finche' non viene invalidato esplicitamente
+  // (e si puo' quindi leggere dalla cache anche da un loop pass, che accetta
+  // solo analisi esterne che PreservedAnalyses::none() non invalida)
+  bool invalidate(Module &M, const PreservedAnalyses &PA,
+                  ModuleAnalysisManager::Invalidator &Inv);
+};
+
+struct PureFunctionsAnalysis : AnalysisInfoMixin<PureFunctionsAnalysis> {
+  using Result = PureFunctions;
+
+  Result run(Module &M, ModuleAnalysisManager &AM)
+  {
+    PureFunctions PF;
+    PF.compute(M);
+    return PF;
+  }
+
+private:
+  friend AnalysisInfoMixin<PureFunctionsAnalysis>;
+  static AnalysisKey Key;
+};
+
+AnalysisKey PureFunctionsAnalysis::Key;
+
+bool PureFunctions::invalidate(Module &M, const PreservedAnalyses &PA,
+                               ModuleAnalysisManager::Invalidator &Inv)
+{
+  return !PA.getChecker<PureFunctionsAnalysis>().preservedWhenStateless();
+}
+
+// Piano di hoisting di un loop: le istruzioni da spostare nel suo preheader,
+// nell'ordine in cui sono state pianificate (un operando prima dei suoi
+// user). Vengono spostate solo alla fine; nel frattempo blockOf restituisce
+// il blocco in cui si troveranno.
+struct HoistPlan {
+  Loop *L = nullptr;
+  SmallSetVector<Instruction*, 16> Istruzioni;
+  bool Guardia = false; //il loop va protetto dal trip count nullo
+
+  void hoist(Instruction *I) { Istruzioni.insert(I); }
+
+  BasicBlock *blockOf(Instruction *I) const
+  {
+    return Istruzioni.count(I) ? L->getLoopPreheader() : I->getParent();
+  }
+};
+
+// Esito di isCandidate: SeIlCorpoEsegue vuol dire che l'istruzione puo' essere
+// spostata solo se il corpo del loop viene eseguito almeno una volta
+enum class Candidatura { No, Si, SeIlCorpoEsegue };
+
+// New PM implementation
+struct TestPass: PassInfoMixin<TestPass> {
+
+  // Reaching definitions della funzione, prese da LICMLoopsPass dalla cache
+  // del FunctionAnalysisManager prima dei loop pass. Senza (es. dentro
+  // loop-mssa(...)) si calcolano per ogni loop.
+  const ReachingDefinitions *RDFunzione = nullptr;
+
+  // Un'istruzione e' loop-invariant se ogni operando e' una costante, un
+  // argomento, una definizione esterna al loop che la raggiunge oppure
+  // un'istruzione del loop gia' marcata come invariante
+  //
+  // Un load e' invariante solo se nessuno store del loop puo' scrivere la
+  // locazione che legge; una chiamata solo se la funzione e' pura (vedi
+  // isCallInvariant); le altre istruzioni con effetti collaterali o che
+  // accedono alla memoria non lo sono mai.
+  bool isLoopInvariant(Instruction &Inst, Loop *L, const ReachingDefinitions &RD,
+                       const HoistPlan &Plan, MemorySSA *MSSA, AAResults *AA,
+                       const PureFunctions &Pure,
+                       const SmallPtrSetImpl<Instruction*> &alreadyInvariant)
+  {
+    //Un PHI sceglie il valore in base al predecessore da cui si arriva
+    if (isa<PHINode>(Inst) || Inst.isTerminator() || Inst.isEHPad() ||
+        isa<AllocaInst>(Inst))
+      return false;
 
-      //Calcolo out[i]=gen[i]U(in[i]-kill[i]) 
-      std::set<Instruction*> outi = geni;
-      for (Instruction *inInst : ini) 
+    if (LoadInst *Load = dyn_cast<LoadInst>(&Inst)) {
+      if (!MSSA || !isLoadInvariant(Load, L, *MSSA, *AA, Pure))
+        return false;
+    } else if (CallInst *Call = dyn_cast<CallInst>(&Inst)) {
+      if (!isCallInvariant(Call, L, MSSA, AA, Pure))
+        return false;
+    } else if (Inst.mayReadOrWriteMemory() || Inst.mayHaveSideEffects()) {
+      return false;
+    }
+
+    for (Value* Operand : Inst.operands()) 
+    {
+      //Se l'operando è un'istruzione
+      if (Instruction* opInst = dyn_cast<Instruction>(Operand))
       {
-        if (killi.find(inInst) == killi.end()) 
+        //Operando definito nel loop: deve essere già nella lista
+        if (L->contains(Plan.blockOf(opInst))) 
         {
-          outi.insert(inInst);
+          if (!alreadyInvariant.count(opInst))
+            return false;
+        } 
+        //Se l'operando è definito fuori dal loop, guardo se arriva a questa istruzione
+        else if (!RD.reachesIn(Plan.blockOf(&Inst), opInst)) 
+        {
+          return false;
         }
+      } else { //Se non è una istruzione, deve essere una costante o argomento
+        if (!isa<Constant>(Operand) && !isa<Argument>(Operand))
+          return false;
       }
+    }
+    return true;
+  }
+
+  // Nessuna MemoryDef del loop (store, chiamate che scrivono, ...) puo'
+  // modificare la locazione letta dal load. Le chiamate a funzioni pure sono
+  // MemoryDef solo perche' MemorySSA non conosce gli attributi dedotti.
+  bool isLoadInvariant(LoadInst *Load, Loop *L, MemorySSA &MSSA, AAResults &AA,
+                       const PureFunctions &Pure)
+  {
+    if (!Load->isSimple())
+      return false;
+    MemoryLocation Loc = MemoryLocation::get(Load);
+    for (BasicBlock *BB : L->blocks())
+      if (auto *Defs = MSSA.getBlockDefs(BB))
+        for (const MemoryAccess &MA : *Defs)
+          if (const MemoryDef *Def = dyn_cast<MemoryDef>(&MA))
+            if (!isPureCall(Def->getMemoryInst(), Pure) &&
+                isModSet(AA.getModRefInfo(Def->getMemoryInst(), Loc)))
+              return false;
+    return true;
+  }
+
+  static bool isPureCall(Instruction *I, const PureFunctions &Pure)
+  {
+    CallBase *Call = dyn_cast<CallBase>(I);
+    if (!Call)
+      return false;
+    EffettiFunzione E = Pure.get(Call);
+    return E.ReadOnly && E.WillReturn && E.NoUnwind;
+  }
+
+  // Una chiamata diretta e' invariante se la funzione termina sempre, non
+  // lancia eccezioni e non scrive in memoria (readnone/readonly, dichiarati o
+  // dedotti da PureFunctions). Se legge memoria, nessuna MemoryDef del loop
+  // deve poter modificare quello che legge.
+  bool isCallInvariant(CallInst *Call, Loop *L, MemorySSA *MSSA, AAResults *AA,
+                       const PureFunctions &Pure)
+  {
+    if (!Call->getCalledFunction() || Call->hasOperandBundles() ||
+        Call->isConvergent() || !isPureCall(Call, Pure))
+      return false;
+    if (Pure.get(Call).ReadNone)
+      return true;
+    if (!MSSA)
+      return false;
+    for (BasicBlock *BB : L->blocks())
+      if (auto *Defs = MSSA->getBlockDefs(BB))
+        for (const MemoryAccess &MA : *Defs)
+          if (const MemoryDef *Def = dyn_cast<MemoryDef>(&MA))
+            if (!isPureCall(Def->getMemoryInst(), Pure) &&
+                isModSet(AA->getModRefInfo(Def->getMemoryInst(), Call)))
+              return false;
+    return true;
+  }
+
+  // Istruzioni loop-invariant di L, in ordine di dipendenza (operandi prima
+  // degli user)
+  std::vector<Instruction*> getLoopInvariants(Loop *L, const ReachingDefinitions &RD,
+                                             const HoistPlan &Plan, MemorySSA *MSSA,
+                                             AAResults *AA, const PureFunctions &Pure)
+  {
+    std::vector<Instruction*> LII;
+    SmallPtrSet<Instruction*, 32> alreadyInvariant;
 
-      //Controllo se out[i] è cambiato
-      if (rd[&bi].second != outi)
+    //Seme: istruzioni i cui operandi vengono tutti da fuori dal loop
+    for (BasicBlock *BB : L->blocks()) 
+    {
+      for (Instruction& Inst : *BB)
       {
-        rd[&bi].second = outi;
-        for (BasicBlock *succ : successors(&bi))
-        {
-          if (std::find(changedNodes.begin(), changedNodes.end(), succ) == changedNodes.end()) 
-          {
-            changedNodes.push_back(succ);
+        if (isLoopInvariant(Inst, L, RD, Plan, MSSA, AA, Pure, alreadyInvariant)) {
+          LII.push_back(&Inst);
+          alreadyInvariant.insert(&Inst);
+        }
+      }
+    }
+
+    //Propago l'invarianza: quando un'istruzione viene marcata ricontrollo
+    //solo i suoi user nel loop, non l'intero corpo
+    for (size_t i = 0; i < LII.size(); i++)
+    {
+      for (User *U : LII[i]->users())
+      {
+        Instruction *UserInst = dyn_cast<Instruction>(U);
+        if (!UserInst || !L->contains(Plan.blockOf(UserInst)) ||
+            alreadyInvariant.count(UserInst))
+          continue;
+        if (isLoopInvariant(*UserInst, L, RD, Plan, MSSA, AA, Pure, alreadyInvariant)) {
+          LII.push_back(UserInst);
+          alreadyInvariant.insert(UserInst);
+        }
+      }
+    }
+    return LII;
+  }
+
+  // Condizioni perche' un'istruzione loop-invariant di L possa essere spostata
+  // nel preheader di L. Uscite e dominanza sono sempre quelle di L.
+  //
+  // In modalita' speculativa le condizioni di dominanza possono essere
+  // sostituite da isSpeculatable. Un'istruzione che domina tutti i latch viene
+  // eseguita ad ogni iterazione: se il corpo gira almeno una volta (trip count
+  // non nullo) si puo' spostare anche se non domina le uscite.
+  //
+  // Le condizioni di dominanza dicono che Inst viene eseguita solo se il
+  // flusso arriva fino a lei: una chiamata che puo' lanciare un'eccezione o
+  // non ritornare puo' fermarlo prima. Come ICFLoopSafetyInfo, se nel loop
+  // c'e' un'istruzione del genere (Bloccante) si fidano della dominanza solo
+  // le istruzioni sicure da eseguire comunque e quelle dell'header che
+  // vengono prima della prima istruzione bloccante.
+  Candidatura isCandidate(Instruction *Inst, Loop *L, ArrayRef<BasicBlock*> ExitBlocks,
+                   DominatorTree &DT, const ReachingDefinitions &RD,
+                   const HoistPlan &Plan, const TargetTransformInfo &TTI,
+                   bool Bloccante)
+  {
+    BasicBlock *InstBB = Plan.blockOf(Inst);
+    // Si trovano in blocchi che dominano tutte le uscite del loop
+    bool dom_uscite = true;
+    for (BasicBlock *ExitBB : ExitBlocks) {
+      if (!DT.dominates(InstBB, ExitBB)) {
+        dom_uscite = false;
+        break;
+      }
+    }
+    // Oppure la variabile definita dall’istruzione è dead all’uscita del loop
+    bool dead = true;
+    for (User *U : Inst->users()) { // Scorro gli user dell'istruzione
+      if (Instruction *UserInst = dyn_cast<Instruction>(U)) {
+        if (L->contains(Plan.blockOf(UserInst))) { // Se è nel loop
+          dead = false;
+          break;
+        }
+      }
+    }
+    // Assegnano un valore a variabili non assegnate altrove nel loop
+    // (in forma SSA e' sempre vero)
+    bool assegn_unico = true;
+    if (!RD.SSA) {
+      for (BasicBlock *LoopBB : L->blocks()) {
+        for (Instruction &OtherInst : *LoopBB) {
+          if (&OtherInst != Inst && OtherInst.getName() == Inst->getName()) {
+            assegn_unico = false;
+            break;
           }
         }
+        if (!assegn_unico) break;
+      }
+    }
+    // Si trovano in blocchi che dominano tutti i blocchi nel loop che usano la variabile a cui si sta assegnando un valore
+    bool dom_all_b = true;
+    for (BasicBlock *LoopBB : L->blocks()) {
+      if (!DT.dominates(InstBB, LoopBB)) {
+        dom_all_b = false;
+        break;
+      }
+    }
+
+    errs() << "Istr: " << *Inst << "\n";
+    errs() << "\t dom_uscite: " << dom_uscite << "\n";
+    errs() << "\t dead: " << dead << "\n";
+    errs() << "\t assegn_unico: " << assegn_unico << "\n";
+    errs() << "\t dom_all_b: " << dom_all_b << "\n";
+
+    // Nessuna istruzione del loop prima di Inst puo' interrompere l'esecuzione
+    bool raggiunta = !Bloccante || isSafeToSpeculativelyExecute(Inst);
+    if (!raggiunta && InstBB == L->getHeader())
+      for (Instruction &I : *InstBB) {
+        if (&I == Inst) {
+          raggiunta = true;
+          break;
+        }
+        if (!isGuaranteedToTransferExecutionToSuccessor(&I))
+          break;
+      }
+    LLVM_DEBUG(dbgs() << "\t raggiunta: " << raggiunta << "\n");
+
+    if (!(dead || assegn_unico))
+      return Candidatura::No;
+    if (dom_uscite && dom_all_b && raggiunta)
+      return Candidatura::Si;
+    bool speculabile = SpeculateOpt && isSpeculatable(Inst, TTI);
+    LLVM_DEBUG(dbgs() << "\t speculabile: " << speculabile << "\n");
+    if (speculabile)
+      return Candidatura::Si;
+
+    SmallVector<BasicBlock*, 4> Latches;
+    L->getLoopLatches(Latches);
+    bool dom_latch = all_of(Latches, [&](BasicBlock *BB) { return DT.dominates(InstBB, BB); });
+    LLVM_DEBUG(dbgs() << "\t dom_latch: " << dom_latch << "\n");
+    return dom_latch && raggiunta ? Candidatura::SeIlCorpoEsegue : Candidatura::No;
+  }
+
+  // Si puo' eseguire anche nei percorsi in cui il loop non l'avrebbe eseguita:
+  // non puo' andare in trap (le divisioni richiedono sempre la dominanza) e il
+  // suo costo non supera la soglia
+  bool isSpeculatable(Instruction *Inst, const TargetTransformInfo &TTI)
+  {
+    switch (Inst->getOpcode()) {
+    case Instruction::UDiv:
+    case Instruction::SDiv:
+    case Instruction::URem:
+    case Instruction::SRem:
+      return false;
+    default:
+      break;
+    }
+    if (!isSafeToSpeculativelyExecute(Inst))
+      return false;
+    InstructionCost Cost =
+        TTI.getInstructionCost(Inst, TargetTransformInfo::TCK_SizeAndLatency);
+    return Cost.isValid() && Cost <= SpeculationThreshold;
+  }
+
+  // LICM su un singolo loop: pianifica lo spostamento nel suo preheader delle
+  // istruzioni candidate. Il LoopPassManager visita i loop interni prima di
+  // quelli esterni: un'istruzione spostata da un loop interno si trova nel
+  // suo preheader, che appartiene al loop esterno, e viene riconsiderata
+  // quando si arriva a lui. Un'istruzione risale quindi un livello alla
+  // volta, una volta per loop. Se il loop interno ha una guardia il suo
+  // preheader non domina piu' i latch del loop esterno, e le istruzioni non
+  // speculabili restano dopo la guardia.
+  void planLoop(Loop *L, DominatorTree &DT, const ReachingDefinitions &RD,
+                MemorySSA *MSSA, AAResults *AA, const PureFunctions &Pure,
+                const TargetTransformInfo &TTI, ScalarEvolution &SE, HoistPlan &Plan)
+  {
+    if (!L->getLoopPreheader())
+      return;
+    Plan.L = L;
+
+    //Il corpo viene eseguito almeno una volta? Se il backedge viene preso
+    //almeno una volta, ogni blocco che domina i latch e' stato eseguito.
+    //Lo stesso vale se si esce solo dal latch (loop do-while, es. ruotato).
+    //Altrimenti, se possibile, lo garantisce una guardia.
+    const SCEV *BTC = SE.getBackedgeTakenCount(L);
+    BasicBlock *Latch = L->getLoopLatch();
+    bool Provato = (!isa<SCEVCouldNotCompute>(BTC) && SE.isKnownNonZero(BTC)) ||
+                   (Latch && L->getExitingBlock() == Latch);
+    bool Guardabile = !Provato && GuardOpt && canGuard(L);
+    LLVM_DEBUG(dbgs() << "Trip count non nullo: "
+                      << (Provato ? "provato" : Guardabile ? "con guardia" : "no") << "\n");
+
+    //Istruzioni Loop-Invariant
+    std::vector<Instruction*> LII = getLoopInvariants(L, RD, Plan, MSSA, AA, Pure);
+    LLVM_DEBUG(dbgs() << "Loop " << L->getHeader()->getName() << " (profondita' "
+                      << L->getLoopDepth() << "): " << LII.size() << " istruzioni loop-invariant\n");
+
+    SmallVector<BasicBlock*, 4> ExitBlocks;
+    L->getExitBlocks(ExitBlocks);
+
+    // C'e' un'istruzione da cui l'esecuzione puo' non proseguire nel loop?
+    bool Bloccante = any_of(L->blocks(), [](BasicBlock *BB) {
+      return any_of(*BB, [](Instruction &I) {
+        return !isGuaranteedToTransferExecutionToSuccessor(&I);
+      });
+    });
+
+    // Cercare istruzioni candidate. LII e' in ordine di dipendenza, quindi
+    // quando guardo un'istruzione so gia' se i suoi operandi nel loop
+    // verranno spostati: se uno resta nel loop, resta anche lei.
+    SmallPtrSet<Instruction*, 32> Candidates, ConGuardia;
+    for (Instruction *Inst : LII) {
+      errs() << "Loop-invariant: " << *Inst << "\n";
+      bool operandiSpostati = true;
+      for (Use &U : Inst->operands())
+        if (Instruction *OpInst = dyn_cast<Instruction>(U.get()))
+          if (L->contains(Plan.blockOf(OpInst)) && !Candidates.count(OpInst)) {
+            operandiSpostati = false;
+            break;
+          }
+      if (!operandiSpostati)
+        continue;
+      // Se tutte le condizioni sono soddisfatte, l'istruzione è candidata per essere spostata
+      Candidatura C = isCandidate(Inst, L, ExitBlocks, DT, RD, Plan, TTI, Bloccante);
+      if (C == Candidatura::Si || (C == Candidatura::SeIlCorpoEsegue && Provato)) {
+        Candidates.insert(Inst);
+      } else if (C == Candidatura::SeIlCorpoEsegue && Guardabile) {
+        Candidates.insert(Inst);
+        ConGuardia.insert(Inst);
+      }
+    }
+
+    if (RegPressureOpt && !Candidates.empty())
+      Candidates = selectByPressure(L, LII, Candidates, Plan, TTI);
+
+    for (Instruction *Inst : LII)
+      if (Candidates.count(Inst)) {
+        Plan.hoist(Inst);
+        Plan.Guardia |= ConGuardia.count(Inst) > 0;
+      }
+  }
+
+  static unsigned registerClass(Value *V, const TargetTransformInfo &TTI)
+  {
+    return TTI.getRegisterClassForType(V->getType()->isVectorTy(), V->getType());
+  }
+
+  // Budget di registri per lo hoisting. Attraverso tutto il loop sono vivi i
+  // PHI dell'header e i valori definiti fuori e usati dentro; i registri che
+  // restano (per classe, secondo TTI) sono il budget. Un'istruzione spostata
+  // occupa un registro se resta usata nel loop; un valore esterno lo libera
+  // se tutti i suoi user nel loop vengono spostati.
+  //
+  // Si sceglie a partire dalle istruzioni piu' costose, ciascuna insieme agli
+  // operandi candidati da cui dipende; quelle che non entrano nel budget
+  // restano nel loop e vengono ricalcolate ad ogni iterazione.
+  SmallPtrSet<Instruction*, 32> selectByPressure(Loop *L, ArrayRef<Instruction*> LII,
+                                                 const SmallPtrSetImpl<Instruction*> &Candidates,
+                                                 const HoistPlan &Plan,
+                                                 const TargetTransformInfo &TTI)
+  {
+    auto inLoop = [&](User *U) {
+      Instruction *UI = dyn_cast<Instruction>(U);
+      return UI && L->contains(Plan.blockOf(UI));
+    };
+
+    //Valori vivi attraverso il loop, per classe
+    DenseMap<unsigned, unsigned> Vivi;
+    SmallSetVector<Value*, 16> Esterni;
+    for (PHINode &PN : L->getHeader()->phis())
+      Vivi[registerClass(&PN, TTI)]++;
+    for (BasicBlock *BB : L->blocks())
+      for (Instruction &I : *BB) {
+        if (!L->contains(Plan.blockOf(&I)))
+          continue;
+        for (Value *Op : I.operands()) {
+          Instruction *OpInst = dyn_cast<Instruction>(Op);
+          if ((isa<Argument>(Op) || (OpInst && !L->contains(Plan.blockOf(OpInst)))) &&
+              Esterni.insert(Op))
+            Vivi[registerClass(Op, TTI)]++;
+        }
+      }
+    LLVM_DEBUG({
+      for (auto &V : Vivi)
+        dbgs() << "Registri: " << V.second << " vivi attraverso il loop su "
+               << TTI.getNumberOfRegisters(V.first) << " ("
+               << TTI.getRegisterClassName(V.first) << ")\n";
+    });
+
+    //La selezione S sta nel budget?
+    auto nelBudget = [&](const SmallPtrSetImpl<Instruction*> &S) {
+      DenseMap<unsigned, int> Delta;
+      for (Instruction *I : S)
+        if (any_of(I->users(), [&](User *U) { return inLoop(U) && !S.count(cast<Instruction>(U)); }))
+          Delta[registerClass(I, TTI)]++;
+      for (Value *V : Esterni)
+        if (all_of(V->users(), [&](User *U) { return !inLoop(U) || S.count(cast<Instruction>(U)); }))
+          Delta[registerClass(V, TTI)]--;
+      for (auto &D : Delta) {
+        int Liberi = (int)TTI.getNumberOfRegisters(D.first) - (int)Vivi.lookup(D.first);
+        if (D.second > 0 && D.second > Liberi)
+          return false;
+      }
+      return true;
+    };
+
+    SmallVector<Instruction*, 16> PerCosto;
+    for (Instruction *I : LII)
+      if (Candidates.count(I))
+        PerCosto.push_back(I);
+    std::stable_sort(PerCosto.begin(), PerCosto.end(), [&](Instruction *A, Instruction *B) {
+      return TTI.getInstructionCost(A, TargetTransformInfo::TCK_SizeAndLatency) >
+             TTI.getInstructionCost(B, TargetTransformInfo::TCK_SizeAndLatency);
+    });
+
+    SmallPtrSet<Instruction*, 32> Scelte;
+    for (Instruction *I : PerCosto) {
+      if (Scelte.count(I))
+        continue;
+      SmallPtrSet<Instruction*, 32> Prova = Scelte;
+      SmallVector<Instruction*, 8> Worklist = {I};
+      while (!Worklist.empty()) {
+        Instruction *J = Worklist.pop_back_val();
+        if (!Prova.insert(J).second)
+          continue;
+        for (Value *Op : J->operands())
+          if (Instruction *OpInst = dyn_cast<Instruction>(Op))
+            if (Candidates.count(OpInst))
+              Worklist.push_back(OpInst);
+      }
+      if (nelBudget(Prova))
+        Scelte = std::move(Prova);
+      else
+        LLVM_DEBUG(dbgs() << "Pressione sui registri: " << *I << " resta nel loop\n");
+    }
+    return Scelte;
+  }
+
+  // Rango di un operando: profondita' del loop in cui e' definito (0 per
+  // costanti, argomenti e valori fuori da ogni loop). Gli operandi di rango
+  // minore della profondita' di L sono invarianti per L.
+  static unsigned rank(Value *V, LoopInfo &LI)
+  {
+    if (Instruction *I = dyn_cast<Instruction>(V))
+      return LI.getLoopDepth(I->getParent());
+    return 0;
+  }
+
+  // Riassociazione: una catena di operazioni uguali, associative e
+  // commutative (interi; floating point solo con reassoc e nsz), con i nodi
+  // interni usati una volta sola, viene appiattita nelle sue foglie. Le
+  // foglie, ordinate per rango, formano una nuova catena sinistra
+  //   ((f0 op f1) op f2) op ...
+  // in cui le foglie invarianti si combinano per prime: i nodi intermedi che
+  // ne risultano sono invarianti e la LICM li sposta. I flag nsw/nuw non
+  // valgono piu' e vengono tolti.
+  bool reassociateLoop(Loop *L, LoopInfo &LI, ScalarEvolution &SE)
+  {
+    auto stessaCatena = [](Value *V, Instruction *Root) {
+      BinaryOperator *B = dyn_cast<BinaryOperator>(V);
+      return B && B->getOpcode() == Root->getOpcode() && B->isAssociative() &&
+             B->hasOneUse();
+    };
+
+    //Radici: operazioni associative non assorbite da un'altra della stessa
+    //catena. Solo i blocchi di L: quelli dei loop interni sono gia' fatti.
+    SmallVector<BinaryOperator*, 16> Radici;
+    for (BasicBlock *BB : L->blocks()) {
+      if (LI.getLoopFor(BB) != L)
+        continue;
+      for (Instruction &I : *BB) {
+        BinaryOperator *B = dyn_cast<BinaryOperator>(&I);
+        if (!B || !B->isAssociative() || !B->isCommutative())
+          continue;
+        Instruction *User = B->hasOneUse() ? dyn_cast<Instruction>(B->user_back()) : nullptr;
+        if (User && L->contains(User->getParent()) && stessaCatena(B, User))
+          continue;
+        Radici.push_back(B);
+      }
+    }
+
+    bool Changed = false;
+    for (BinaryOperator *Root : Radici) {
+      //Foglie in ordine (operando 0 prima dell'1) e nodi interni
+      SmallVector<Value*, 8> Foglie;
+      SmallVector<Instruction*, 8> Interni;
+      bool CatenaSinistra = true;
+      std::function<void(Value*, bool)> visita = [&](Value *V, bool Destro) {
+        Instruction *I = dyn_cast<Instruction>(V);
+        if (V != Root && (!I || !L->contains(I->getParent()) || !stessaCatena(V, Root))) {
+          Foglie.push_back(V);
+          return;
+        }
+        if (Destro)
+          CatenaSinistra = false;
+        if (V != Root)
+          Interni.push_back(I);
+        visita(I->getOperand(0), false);
+        visita(I->getOperand(1), true);
+      };
+      visita(Root, false);
+
+      unsigned Profondita = L->getLoopDepth();
+      unsigned Invarianti = count_if(Foglie, [&](Value *V) { return rank(V, LI) < Profondita; });
+      if (Foglie.size() < 3 || Invarianti < 2 || Invarianti == Foglie.size())
+        continue;
+      //Gia' in ordine?
+      bool Ordinata = CatenaSinistra;
+      for (size_t k = 1; k < Foglie.size() && Ordinata; k++)
+        if (rank(Foglie[k - 1], LI) > rank(Foglie[k], LI))
+          Ordinata = false;
+      if (Ordinata)
+        continue;
+
+      std::stable_sort(Foglie.begin(), Foglie.end(), [&](Value *A, Value *B) {
+        return rank(A, LI) < rank(B, LI);
+      });
+      LLVM_DEBUG(dbgs() << "Riassocio:" << *Root << " ->");
+      IRBuilder<> Builder(Root);
+      //I nuovi nodi mescolano operazioni di tutta la catena: solo i flag che
+      //valgono per ognuna (reassoc e nsz ci sono, li richiede isAssociative)
+      if (isa<FPMathOperator>(Root)) {
+        FastMathFlags FMF = Root->getFastMathFlags();
+        for (Instruction *I : Interni)
+          FMF &= I->getFastMathFlags();
+        Builder.setFastMathFlags(FMF);
+        Root->copyFastMathFlags(FMF);
+      }
+      Value *Acc = Foglie[0];
+      for (size_t k = 1; k + 1 < Foglie.size(); k++)
+        Acc = Builder.CreateBinOp(Root->getOpcode(), Acc, Foglie[k], Root->getName() + ".reass");
+      Root->setOperand(0, Acc);
+      Root->setOperand(1, Foglie.back());
+      Root->dropPoisonGeneratingFlags();
+      LLVM_DEBUG(dbgs() << *Root << "\n");
+      SE.forgetValue(Root);
+
+      //I vecchi nodi interni non servono piu'
+      for (Instruction *I : Interni)
+        I->dropAllReferences();
+      for (Instruction *I : Interni)
+        I->eraseFromParent();
+      Changed = true;
+    }
+    return Changed;
+  }
+
+  // Si puo' mettere una guardia sul trip count nullo? Solo per i loop con il
+  // test nell'header (l'unico blocco che esce) e un'unica uscita dedicata: la
+  // guardia e' una copia del test dell'header valutata sui valori iniziali
+  // dei PHI, che non deve avere effetti collaterali.
+  bool canGuard(Loop *L)
+  {
+    BasicBlock *Header = L->getHeader();
+    BasicBlock *Exit = L->getUniqueExitBlock();
+    if (!L->getLoopPreheader() || !Exit || L->getExitingBlock() != Header ||
+        !L->hasDedicatedExits())
+      return false;
+    BranchInst *Br = dyn_cast<BranchInst>(Header->getTerminator());
+    if (!Br || !Br->isConditional())
+      return false;
+    for (Instruction &I : *Header)
+      if (!isa<PHINode>(I) && !I.isTerminator() && I.mayHaveSideEffects())
+        return false;
+    return true;
+  }
+
+  // Valore di V utilizzabile nell'uscita ExitBB di L senza rompere la forma
+  // LCSSA: se V e' definito nel loop passa per un PHI dell'uscita (riuso
+  // quello che esiste gia')
+  static Value *valoreLCSSA(Value *V, BasicBlock *ExitBB, Loop *L)
+  {
+    Instruction *I = dyn_cast<Instruction>(V);
+    if (!I || !L->contains(I->getParent()))
+      return V;
+    for (PHINode &PN : ExitBB->phis())
+      if (PN.getType() == V->getType() &&
+          all_of(PN.incoming_values(), [&](Value *In) { return In == V; }))
+        return &PN;
+    PHINode *PN = PHINode::Create(V->getType(), pred_size(ExitBB),
+                                  V->getName() + ".lcssa", &ExitBB->front());
+    for (BasicBlock *Pred : predecessors(ExitBB))
+      PN->addIncoming(V, Pred);
+    return PN;
+  }
+
+  // Inserisce la guardia: il vecchio preheader diventa il blocco di guardia,
+  // che valuta il test dell'header sui valori iniziali e salta direttamente
+  // all'uscita se il corpo non verrebbe mai eseguito; dopo c'e' un nuovo
+  // preheader, dove finiscono le istruzioni spostate. Il loop resta in forma
+  // normale: l'arco header -> uscita passa per un nuovo blocco di uscita
+  // dedicato, con i PHI LCSSA dei valori usati dopo il loop. Dominator tree,
+  // LoopInfo, MemorySSA e scalar evolution vengono aggiornati.
+  void insertZeroTripGuard(Loop *L, DominatorTree &DT, LoopInfo &LI,
+                           ScalarEvolution &SE, MemorySSAUpdater *MSSAU)
+  {
+    BasicBlock *Header = L->getHeader();
+    BasicBlock *Exit = L->getUniqueExitBlock();
+    BasicBlock *Guard = L->getLoopPreheader();
+    BasicBlock *NewPreheader = SplitEdge(Guard, Header, &DT, &LI, MSSAU);
+    NewPreheader->setName(Header->getName() + ".ph");
+    BasicBlock *LoopExit = SplitBlockPredecessors(Exit, {Header}, ".loopexit", &DT,
+                                                  &LI, MSSAU, /*PreserveLCSSA=*/true);
+
+    //Copia delle istruzioni dell'header nella guardia (PHI -> valore iniziale)
+    ValueToValueMapTy VMap;
+    SmallVector<Instruction*, 8> Copie;
+    for (Instruction &I : *Header) {
+      if (PHINode *PN = dyn_cast<PHINode>(&I)) {
+        VMap[PN] = PN->getIncomingValueForBlock(NewPreheader);
+        continue;
       }
+      if (I.isTerminator())
+        break;
+      Instruction *C = I.clone();
+      C->setName(I.getName() + ".guard");
+      RemapInstruction(C, VMap, RF_NoModuleLevelChanges | RF_IgnoreMissingLocals);
+      C->insertBefore(Guard->getTerminator());
+      if (MSSAU && C->mayReadFromMemory()) {
+        MemoryAccess *MA = MSSAU->createMemoryAccessInBB(C, nullptr, Guard,
+                                                         MemorySSA::BeforeTerminator);
+        MSSAU->insertUse(cast<MemoryUse>(MA), /*RenameUses=*/true);
+      }
+      VMap[&I] = C;
+      Copie.push_back(C);
+    }
+    auto mapped = [&](Value *V) -> Value* {
+      auto It = VMap.find(V);
+      return It == VMap.end() ? V : static_cast<Value*>(It->second);
+    };
+
+    //I PHI dell'uscita ricevono dalla guardia il valore che avrebbe avuto
+    //il loop uscendo subito dall'header
+    for (PHINode &PN : Exit->phis()) {
+      Value *V = PN.getIncomingValueForBlock(LoopExit);
+      if (PHINode *LP = dyn_cast<PHINode>(V))
+        if (LP->getParent() == LoopExit)
+          V = LP->getIncomingValueForBlock(Header);
+      PN.addIncoming(mapped(V), Guard);
+      SE.forgetValue(&PN);
     }
 
+    BranchInst *HeaderBr = cast<BranchInst>(Header->getTerminator());
+    Value *Cond = mapped(HeaderBr->getCondition());
+    Instruction *OldTerm = Guard->getTerminator();
+    if (HeaderBr->getSuccessor(0) == LoopExit)
+      BranchInst::Create(Exit, NewPreheader, Cond, OldTerm);
+    else
+      BranchInst::Create(NewPreheader, Exit, Cond, OldTerm);
+    OldTerm->eraseFromParent();
 
-    return rd;
+    //Le copie che non servono alla guardia si possono togliere
+    for (Instruction *C : reverse(Copie))
+      if (C->use_empty()) {
+        if (MSSAU)
+          MSSAU->removeMemoryAccess(C);
+        C->eraseFromParent();
+      }
 
+    //Ora l'uscita e' raggiungibile anche dalla guardia
+    SmallVector<DominatorTree::UpdateType, 1> Updates = {{DominatorTree::Insert, Guard, Exit}};
+    DT.applyUpdates(Updates);
+    if (MSSAU)
+      MSSAU->applyUpdates(Updates, DT);
+    SE.forgetLoop(L);
+    LLVM_DEBUG(dbgs() << "Guardia sul trip count nullo in " << Guard->getName() << " per il loop "
+                      << Header->getName() << "\n");
   }
 
-  std::vector<std::pair<Instruction*,Loop*>> getLoopInvariants(LoopInfo &LI, 
-                                                              std::map<BasicBlock*,std::pair<std::set<Instruction*>,std::set<Instruction*>>> rd)
+  // Esegue il piano: mette la guardia se serve e sposta le istruzioni nel
+  // preheader nell'ordine del piano, che e' gia' topologico. I load spostati
+  // portano con se' il loro accesso in MemorySSA.
+  bool applyPlan(const HoistPlan &Plan, DominatorTree &DT, LoopInfo &LI,
+                 ScalarEvolution &SE, MemorySSAUpdater *MSSAU)
   {
-    //Vettore di coppie istruzioni Loop-Invariant e loop a cui appartiene
-    std::vector<std::pair<Instruction*,Loop*>> LII;
+    if (Plan.Istruzioni.empty())
+      return false;
+    if (Plan.Guardia)
+      insertZeroTripGuard(Plan.L, DT, LI, SE, MSSAU);
+    BasicBlock *Preheader = Plan.L->getLoopPreheader();
+    for (Instruction *I : Plan.Istruzioni) {
+      errs() << "Sposto: " << *I << " nel preheader " << Preheader->getName() << "\n";
+      I->moveBefore(Preheader->getTerminator());
+      if (MSSAU)
+        if (MemoryUseOrDef *MA = MSSAU->getMemorySSA()->getMemoryAccess(I))
+          MSSAU->moveToPlace(MA, Preheader, MemorySSA::BeforeTerminator);
+      SE.forgetValue(I);
+    }
+    return true;
+  }
+
+  // Promozione a registro di una locazione invariante del loop: un load nel
+  // preheader, i load/store nel loop sostituiti dai valori SSA (SSAUpdater)
+  // e uno store per ogni uscita con il valore live-out (tramite un PHI LCSSA).
+  // MemorySSA, se c'e', segue gli accessi creati e cancellati.
+  struct LoopPromoter : LoadAndStorePromoter {
+    Value *Ptr;
+    Loop *L;
+    ArrayRef<BasicBlock*> ExitBlocks;
+    Align Alignment;
+    SSAUpdater &SSA;
+    MemorySSAUpdater *MSSAU;
 
-    for (Loop *L: LI)
+    LoopPromoter(ArrayRef<const Instruction*> Insts, SSAUpdater &S, Value *P,
+                 Loop *Lp, ArrayRef<BasicBlock*> Exits, Align A,
+                 MemorySSAUpdater *U)
+        : LoadAndStorePromoter(Insts, S), Ptr(P), L(Lp), ExitBlocks(Exits),
+          Alignment(A), SSA(S), MSSAU(U) {}
+
+    void doExtraRewritesBeforeFinalDeletion() override
     {
+      for (BasicBlock *ExitBB : ExitBlocks) {
+        Value *LiveOut = valoreLCSSA(SSA.GetValueInMiddleOfBlock(ExitBB), ExitBB, L);
+        StoreInst *SI = new StoreInst(LiveOut, Ptr, false, Alignment,
+                                      &*ExitBB->getFirstInsertionPt());
+        if (MSSAU) {
+          MemoryAccess *MA = MSSAU->createMemoryAccessInBB(SI, nullptr, ExitBB,
+                                                           MemorySSA::Beginning);
+          MSSAU->insertDef(cast<MemoryDef>(MA), /*RenameUses=*/true);
+        }
+      }
+    }
 
-      std::set<Instruction*> alreadyInvariant;
+    void instructionDeleted(Instruction *I) const override
+    {
+      if (MSSAU)
+        MSSAU->removeMemoryAccess(I);
+    }
+  };
 
-      bool changed;
+  // Cerca in L le locazioni a indirizzo invariante lette e scritte ad ogni
+  // iterazione e le promuove a registro. Condizioni:
+  //  - tutti gli accessi al puntatore sono load/store semplici dello stesso tipo;
+  //  - almeno uno store domina latch e uscite (viene eseguito ad ogni
+  //    iterazione, quindi il load nel preheader e gli store alle uscite sono
+  //    sicuri);
+  //  - nessun altro accesso a memoria del loop puo' fare alias con la locazione.
+  bool promoteLoop(Loop *L, DominatorTree &DT, AAResults &AA, MemorySSAUpdater *MSSAU)
+  {
+    BasicBlock *Preheader = L->getLoopPreheader();
+    if (!Preheader || !L->hasDedicatedExits())
+      return false;
+    SmallVector<BasicBlock*, 4> ExitBlocks, Latches;
+    L->getUniqueExitBlocks(ExitBlocks);
+    L->getLoopLatches(Latches);
+    if (ExitBlocks.empty())
+      return false;
 
-      do {
+    //Accessi del loop raggruppati per puntatore invariante
+    MapVector<Value*, SmallVector<Instruction*, 4>> Accessi;
+    SmallVector<Instruction*, 8> AltriAccessi;
+    for (BasicBlock *BB : L->blocks())
+      for (Instruction &I : *BB) {
+        if (!I.mayReadOrWriteMemory())
+          continue;
+        Value *Ptr = getLoadStorePointerOperand(&I);
+        bool Semplice = (isa<LoadInst>(I) && cast<LoadInst>(I).isSimple()) ||
+                        (isa<StoreInst>(I) && cast<StoreInst>(I).isSimple());
+        if (Ptr && Semplice && L->isLoopInvariant(Ptr))
+          Accessi[Ptr].push_back(&I);
+        else
+          AltriAccessi.push_back(&I);
+      }
 
-        changed = false;
+    bool Changed = false;
+    for (auto &A : Accessi) {
+      Value *Ptr = A.first;
+      SmallVector<Instruction*, 4> &Insts = A.second;
+      Type *Ty = getLoadStoreType(Insts.front());
+      Align Alignment = getLoadStoreAlignment(Insts.front());
+      bool Promuovibile = false; //c'e' uno store eseguito ad ogni iterazione
+      bool Scritto = false;
+      for (Instruction *I : Insts) {
+        if (getLoadStoreType(I) != Ty) {
+          Promuovibile = false;
+          break;
+        }
+        Alignment = std::min(Alignment, getLoadStoreAlignment(I));
+        if (!isa<StoreInst>(I))
+          continue;
+        Scritto = true;
+        if (all_of(Latches, [&](BasicBlock *BB) { return DT.dominates(I->getParent(), BB); }) &&
+            all_of(ExitBlocks, [&](BasicBlock *BB) { return DT.dominates(I->getParent(), BB); }))
+          Promuovibile = true;
+      }
+      if (!Promuovibile)
+        continue;
 
-        for (BasicBlock *BB : L->blocks()) 
-        {
-          const auto &BBrd = rd.at(BB).first; //in[BB]
+      //Nessun alias con gli altri accessi del loop
+      MemoryLocation Loc = MemoryLocation::get(Insts.front());
+      for (Instruction *I : AltriAccessi)
+        if (isModOrRefSet(AA.getModRefInfo(I, Loc))) {
+          Promuovibile = false;
+          break;
+        }
+      for (auto &B : Accessi) {
+        if (!Promuovibile)
+          break;
+        if (B.first == Ptr)
+          continue;
+        for (Instruction *I : B.second)
+          if ((Scritto || isa<StoreInst>(I)) &&
+              !AA.isNoAlias(Loc, MemoryLocation::get(I))) {
+            Promuovibile = false;
+            break;
+          }
+      }
+      if (!Promuovibile)
+        continue;
 
-          for (Instruction& Inst : *BB)
-          {
+      LLVM_DEBUG(dbgs() << "Promuovo a registro " << *Ptr << " nel loop "
+                        << L->getHeader()->getName() << " (" << Insts.size() << " accessi)\n");
 
-            //delta function, se l'istruzione è già stata marcata vado avanti
-            if (std::any_of(LII.begin(), LII.end(),
-                          [&](auto &p) { return p.first == &Inst && p.second == L; }))
-                          continue;
-          
-            bool isLoopInvariant = true;
+      SmallVector<PHINode*, 8> NewPHIs;
+      SSAUpdater SSA(&NewPHIs);
+      SmallVector<const Instruction*, 4> ConstInsts(Insts.begin(), Insts.end());
+      LoopPromoter Promoter(ConstInsts, SSA, Ptr, L, ExitBlocks, Alignment, MSSAU);
+      LoadInst *PreLoad = new LoadInst(Ty, Ptr, Ptr->getName() + ".promoted", false,
+                                       Alignment, Preheader->getTerminator());
+      if (MSSAU) {
+        MemoryAccess *MA = MSSAU->createMemoryAccessInBB(PreLoad, nullptr, Preheader,
+                                                         MemorySSA::End);
+        MSSAU->insertUse(cast<MemoryUse>(MA), /*RenameUses=*/true);
+      }
+      SSA.AddAvailableValue(Preheader, PreLoad);
+      Promoter.run(Insts);
+      if (PreLoad->use_empty()) {
+        if (MSSAU)
+          MSSAU->removeMemoryAccess(PreLoad);
+        PreLoad->eraseFromParent();
+      }
+      Changed = true;
+    }
+    return Changed;
+  }
 
-            for (Value* Operand : Inst.operands()) 
-            {
-            
-              //Se l'operando è un'istruzione
-              if (Instruction* opInst = dyn_cast<Instruction>(Operand))
-              {
-                //Operando definito nel loop
-                if (L->contains(opInst->getParent())) 
-                {
-                  //Verifico se è loop-invariant (deve essere già nella lista)
-                  if (alreadyInvariant.find(opInst) == alreadyInvariant.end())
-                  {
-                    isLoopInvariant = false;
-                    break;
-                  }
-                } 
-                //Se la definizione viene da fuori il loop, verifica che sia nelle reaching definitions
-                else 
-                {
-                  //Se l'operando è definito fuori dal loop, guardo se arriva a questa istruzione
-                  if (BBrd.find(opInst) == BBrd.end()) 
-                  {
-                    isLoopInvariant = false;
-                    break;
-                  }
-                }
-              } else { //Se non è una istruzione, deve essere una costante o argomento
-                if (!isa<Constant>(Operand) && !isa<Argument>(Operand))
-                {
-                  isLoopInvariant = false;
-                  break;
-                }
-              }
-          
+  // Sinking: un'istruzione del loop il cui valore e' usato solo fuori dal loop
+  // (il flag dead di isCandidate) viene spostata nelle uscite, cosi' viene
+  // calcolata una volta sola invece che ad ogni iterazione. Se la usano piu'
+  // uscite ne metto una copia in ciascuna. In SSA ogni uso e' dominato dal
+  // blocco dell'istruzione, quindi gli operandi all'uscita hanno ancora il
+  // valore dell'ultima iterazione; quelli definiti nel loop vengono letti
+  // attraverso i PHI LCSSA dell'uscita.
+  bool sinkLoop(Loop *L, DominatorTree &DT, ScalarEvolution &SE)
+  {
+    if (!L->hasDedicatedExits())
+      return false;
+    SmallVector<BasicBlock*, 4> ExitBlocks;
+    L->getUniqueExitBlocks(ExitBlocks);
+
+    SmallVector<Instruction*, 32> Worklist;
+    for (BasicBlock *BB : L->blocks())
+      for (Instruction &I : *BB)
+        Worklist.push_back(&I);
+
+    //Gli originali copiati in piu' uscite restano senza operandi fino alla
+    //fine: la Worklist puo' contenerli ancora
+    SmallVector<Instruction*, 8> DaCancellare;
+    bool Changed = false;
+    while (!Worklist.empty()) {
+      Instruction *I = Worklist.pop_back_val();
+      if (!L->contains(I->getParent()) || I->use_empty() || isa<PHINode>(I) ||
+          I->isTerminator() || I->isEHPad() || isa<AllocaInst>(I) ||
+          I->mayReadOrWriteMemory() || I->mayHaveSideEffects())
+        continue;
+
+      //Per ogni uso cerco l'uscita che lo domina. Un PHI di un'uscita che
+      //riceve solo I (forma LCSSA) viene sostituito per intero.
+      SmallVector<std::pair<Use*, BasicBlock*>, 8> Usi;
+      SmallVector<std::pair<PHINode*, BasicBlock*>, 4> PhiUscite;
+      bool soloFuori = true;
+      for (Use &U : I->uses()) {
+        Instruction *UserInst = cast<Instruction>(U.getUser());
+        BasicBlock *UseBB = UserInst->getParent();
+        PHINode *PN = dyn_cast<PHINode>(UserInst);
+        if (PN && is_contained(ExitBlocks, UseBB) &&
+            all_of(PN->incoming_values(), [&](Value *V) { return V == I; })) {
+          if (!is_contained(PhiUscite, std::make_pair(PN, UseBB)))
+            PhiUscite.push_back({PN, UseBB});
+          continue;
+        }
+        if (PN)
+          UseBB = PN->getIncomingBlock(U);
+        BasicBlock *Uscita = nullptr;
+        if (!L->contains(UseBB))
+          for (BasicBlock *ExitBB : ExitBlocks)
+            if (DT.dominates(ExitBB, UseBB)) {
+              Uscita = ExitBB;
+              break;
             }
+        if (!Uscita) {
+          soloFuori = false;
+          break;
+        }
+        Usi.push_back({&U, Uscita});
+      }
+      if (!soloFuori)
+        continue;
+
+      //Una copia per ogni uscita che serve (l'originale se ne basta una)
+      SmallVector<BasicBlock*, 4> Uscite;
+      for (auto &p : Usi)
+        if (!is_contained(Uscite, p.second))
+          Uscite.push_back(p.second);
+      for (auto &p : PhiUscite)
+        if (!is_contained(Uscite, p.second))
+          Uscite.push_back(p.second);
+
+      DenseMap<BasicBlock*, Instruction*> Copie;
+      SmallVector<Instruction*, 4> Operandi;
+      for (Use &Op : I->operands())
+        if (Instruction *OpInst = dyn_cast<Instruction>(Op.get()))
+          if (L->contains(OpInst->getParent()))
+            Operandi.push_back(OpInst);
+      SE.forgetValue(I);
+      for (BasicBlock *ExitBB : Uscite) {
+        Instruction *Copia = I;
+        if (Uscite.size() > 1) {
+          Copia = I->clone();
+          Copia->setName(I->getName() + ".sink");
+          Copia->insertBefore(&*ExitBB->getFirstInsertionPt());
+        } else {
+          I->moveBefore(&*ExitBB->getFirstInsertionPt());
+        }
+        for (Use &Op : Copia->operands())
+          Op.set(valoreLCSSA(Op.get(), ExitBB, L));
+        Copie[ExitBB] = Copia;
+        LLVM_DEBUG(dbgs() << "Sink: " << *Copia << " nell'uscita " << ExitBB->getName() << "\n");
+      }
+      for (auto &p : Usi)
+        p.first->set(Copie[p.second]);
+      for (auto &p : PhiUscite) {
+        p.first->replaceAllUsesWith(Copie[p.second]);
+        p.first->eraseFromParent();
+      }
+      if (Uscite.size() > 1) {
+        I->dropAllReferences();
+        DaCancellare.push_back(I);
+      }
+      Changed = true;
+
+      //Gli operandi nel loop potrebbero ora essere usati solo fuori
+      for (Instruction *OpInst : Operandi)
+        Worklist.push_back(OpInst);
+    }
+    for (Instruction *I : DaCancellare)
+      I->eraseFromParent();
+    return Changed;
+  }
 
-            if (isLoopInvariant) {
-              LII.emplace_back(&Inst, L);
-              alreadyInvariant.insert(&Inst);
-              changed = true; //L'ho aggiunta, quindi è cambiato
+  // Hoisting delle costanti: un operando costante che secondo il TTI non entra
+  // nell'istruzione come immediato (es. un intero a 64 bit su x86-64 o
+  // AArch64) viene materializzato dal backend in ogni blocco che lo usa, cioe'
+  // ad ogni iterazione. Lo materializzo una volta nel preheader con un
+  // bitcast opaco (come ConstantHoisting) e lo condivido fra tutti gli usi
+  // del loop. Un GEP costante diventa un'istruzione nel preheader se il suo
+  // offset e' costoso o se lo usano piu' istruzioni del loop.
+  bool hoistConstants(Loop *L, const TargetTransformInfo &TTI, ScalarEvolution &SE)
+  {
+    BasicBlock *Preheader = L->getLoopPreheader();
+    if (!Preheader)
+      return false;
+    const DataLayout &DL = Preheader->getModule()->getDataLayout();
+
+    MapVector<Constant*, SmallVector<Use*, 4>> Usi;
+    SmallPtrSet<Constant*, 8> Costose;
+    for (BasicBlock *BB : L->blocks())
+      for (Instruction &I : *BB) {
+        // Operandi che devono restare costanti o che il backend tratta a parte
+        // (e i bitcast delle costanti gia' materializzate)
+        if (isa<PHINode>(I) || isa<IntrinsicInst>(I) || isa<BitCastInst>(I) || isa<SwitchInst>(I) ||
+            isa<ShuffleVectorInst>(I) || isa<AllocaInst>(I) || I.isEHPad())
+          continue;
+        for (Use &U : I.operands()) {
+          unsigned Idx = U.getOperandNo();
+          if (!canReplaceOperandWithVariable(&I, Idx))
+            continue;
+          if (auto *CI = dyn_cast<ConstantInt>(U.get())) {
+            InstructionCost Costo = TTI.getIntImmCostInst(
+                I.getOpcode(), Idx, CI->getValue(), CI->getType(),
+                TargetTransformInfo::TCK_SizeAndLatency, &I);
+            if (Costo > TargetTransformInfo::TCC_Basic) {
+              Usi[CI].push_back(&U);
+              Costose.insert(CI);
             }
+          } else if (auto *CE = dyn_cast<ConstantExpr>(U.get())) {
+            auto *GEP = dyn_cast<GEPOperator>(CE);
+            if (!GEP)
+              continue;
+            APInt Offset(DL.getIndexTypeSizeInBits(GEP->getType()), 0);
+            if (!GEP->accumulateConstantOffset(DL, Offset))
+              continue;
+            Usi[CE].push_back(&U);
+            InstructionCost Costo = TTI.getIntImmCostInst(
+                Instruction::Add, 1, Offset, DL.getIndexType(GEP->getType()),
+                TargetTransformInfo::TCK_SizeAndLatency, nullptr);
+            if (Costo > TargetTransformInfo::TCC_Basic)
+              Costose.insert(CE);
           }
         }
-      } while (changed); //Finchè cambia
+      }
+
+    bool Changed = false;
+    Instruction *InsertPt = Preheader->getTerminator();
+    for (auto &[C, Lista] : Usi) {
+      if (!Costose.count(C) && Lista.size() < 2)
+        continue;
+      Instruction *Mat;
+      if (auto *CE = dyn_cast<ConstantExpr>(C)) {
+        Mat = CE->getAsInstruction();
+        Mat->insertBefore(InsertPt);
+      } else {
+        Mat = new BitCastInst(C, C->getType(), "const", InsertPt);
+      }
+      LLVM_DEBUG(dbgs() << "Costante materializzata nel preheader " << Preheader->getName()
+                        << " (" << Lista.size() << " usi): " << *Mat << "\n");
+      for (Use *U : Lista) {
+        SE.forgetValue(U->getUser());
+        U->set(Mat);
+      }
+      Changed = true;
     }
-    return LII;
+    return Changed;
   }
 
-  // Main entry point, takes IR unit to run the pass on (&F) and the
-  // corresponding pass manager (to be queried if need be)
-  PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM) {
+  // Rotazione: il loop
+  //
+  //   preheader -> header: test ? corpo : uscita     latch -> header
+  //
+  // diventa un do-while con guardia. La guardia (insertZeroTripGuard) copia
+  // il test dell'header sui valori iniziali; il vecchio header, raggiunto
+  // solo se il test e' vero, esce dal loop e salta dritto al corpo, che
+  // diventa il nuovo header. Il test viene ricopiato nel latch sui valori
+  // della prossima iterazione e il latch diventa l'unico blocco che esce.
+  // I valori dell'header (PHI e istruzioni) usati nel loop passano per PHI
+  // nel nuovo header: valore iniziale dal vecchio header, copia del latch
+  // dal back-edge.
+  //
+  // Condizioni: quelle della guardia, un unico latch che torna all'header
+  // con un salto incondizionato, un header piccolo che non accede alla
+  // memoria e un corpo raggiunto solo dall'header.
+  bool rotateLoop(Loop *L, DominatorTree &DT, LoopInfo &LI, ScalarEvolution &SE,
+                  MemorySSAUpdater *MSSAU)
+  {
+    BasicBlock *Header = L->getHeader();
+    BasicBlock *Latch = L->getLoopLatch();
+    if (!canGuard(L) || !Latch || Latch == Header)
+      return false;
+    BranchInst *LatchBr = dyn_cast<BranchInst>(Latch->getTerminator());
+    if (!LatchBr || LatchBr->isConditional())
+      return false;
+    BranchInst *HeaderBr = cast<BranchInst>(Header->getTerminator());
+    unsigned InLoop = L->contains(HeaderBr->getSuccessor(0)) ? 0 : 1;
+    BasicBlock *Body = HeaderBr->getSuccessor(InLoop);
+    if (Body->getSinglePredecessor() != Header)
+      return false;
+    unsigned Dimensione = 0;
+    for (Instruction &I : *Header) {
+      if (isa<PHINode>(I) || I.isTerminator())
+        continue;
+      if (I.mayReadOrWriteMemory() || ++Dimensione > RotateMaxHeader)
+        return false;
+    }
+
+    insertZeroTripGuard(L, DT, LI, SE, MSSAU);
+    BasicBlock *NewPreheader = L->getLoopPreheader();
+    BasicBlock *LoopExit = L->getUniqueExitBlock();
+
+    //Valori dell'header alla fine di un'iterazione: PHI -> valore dal latch,
+    //istruzioni -> copie nel latch
+    ValueToValueMapTy VMap;
+    SmallVector<Instruction*, 8> Valori;
+    for (PHINode &PN : Header->phis()) {
+      VMap[&PN] = PN.getIncomingValueForBlock(Latch);
+      Valori.push_back(&PN);
+    }
+    Instruction *CondLatch = nullptr;
+    for (Instruction &I : *Header) {
+      if (isa<PHINode>(I))
+        continue;
+      if (I.isTerminator())
+        break;
+      Instruction *C = I.clone();
+      C->setName(I.getName() + ".rot");
+      RemapInstruction(C, VMap, RF_NoModuleLevelChanges | RF_IgnoreMissingLocals);
+      C->insertBefore(LatchBr);
+      VMap[&I] = C;
+      Valori.push_back(&I);
+      if (&I == HeaderBr->getCondition())
+        CondLatch = C;
+    }
+    auto mapped = [&](Value *V) -> Value* {
+      auto It = VMap.find(V);
+      return It == VMap.end() ? V : static_cast<Value*>(It->second);
+    };
+
+    //Il latch esce con il test sui valori della prossima iterazione
+    Value *Cond = CondLatch ? CondLatch : mapped(HeaderBr->getCondition());
+    if (InLoop == 0)
+      BranchInst::Create(Body, LoopExit, Cond, LatchBr);
+    else
+      BranchInst::Create(LoopExit, Body, Cond, LatchBr);
+    LatchBr->eraseFromParent();
+    for (PHINode &PN : LoopExit->phis()) {
+      int k = PN.getBasicBlockIndex(Header);
+      PN.setIncomingBlock(k, Latch);
+      PN.setIncomingValue(k, mapped(PN.getIncomingValue(k)));
+    }
+
+    //PHI nel nuovo header per i valori dell'header. Prima li creo tutti: il
+    //valore dal back-edge puo' essere a sua volta un valore dell'header
+    SmallVector<PHINode*, 8> NuoviPhi;
+    SmallPtrSet<PHINode*, 8> Nuovi;
+    for (Instruction *V : Valori) {
+      PHINode *PN = PHINode::Create(V->getType(), 2, V->getName() + ".body", &Body->front());
+      Value *Iniziale = isa<PHINode>(V) ? cast<PHINode>(V)->getIncomingValueForBlock(NewPreheader)
+                                        : static_cast<Value*>(V);
+      PN->addIncoming(Iniziale, Header);
+      PN->addIncoming(mapped(V), Latch);
+      NuoviPhi.push_back(PN);
+      Nuovi.insert(PN);
+    }
+    //Dopo l'header si usano i nuovi PHI (tranne che per il valore iniziale)
+    for (unsigned k = 0; k < Valori.size(); k++) {
+      SmallVector<Use*, 8> Usi;
+      for (Use &U : Valori[k]->uses()) {
+        Instruction *UserInst = cast<Instruction>(U.getUser());
+        PHINode *UserPN = dyn_cast<PHINode>(UserInst);
+        if (UserInst->getParent() == Header ||
+            (UserPN && Nuovi.count(UserPN) && UserPN->getIncomingBlock(U) == Header))
+          continue;
+        Usi.push_back(&U);
+      }
+      for (Use *U : Usi)
+        U->set(NuoviPhi[k]);
+    }
+    //Via i PHI che non servono (usati al piu' da se stessi)
+    for (bool Cambiato = true; Cambiato;) {
+      Cambiato = false;
+      for (PHINode *&PN : NuoviPhi)
+        if (PN && all_of(PN->users(), [&](User *U) { return U == PN; })) {
+          PN->replaceAllUsesWith(UndefValue::get(PN->getType()));
+          PN->eraseFromParent();
+          PN = nullptr;
+          Cambiato = true;
+        }
+    }
+
+    //Il vecchio header viene eseguito una volta sola, dopo la guardia
+    for (PHINode &PN : make_early_inc_range(Header->phis())) {
+      PN.replaceAllUsesWith(PN.getIncomingValueForBlock(NewPreheader));
+      PN.eraseFromParent();
+    }
+    BranchInst::Create(Body, HeaderBr);
+    HeaderBr->eraseFromParent();
+    for (Instruction &I : make_early_inc_range(reverse(*Header)))
+      if (!I.isTerminator() && I.use_empty())
+        I.eraseFromParent();
+
+    SmallVector<DominatorTree::UpdateType, 4> Updates = {
+        {DominatorTree::Delete, Header, LoopExit},
+        {DominatorTree::Delete, Latch, Header},
+        {DominatorTree::Insert, Latch, LoopExit},
+        {DominatorTree::Insert, Latch, Body}};
+    DT.applyUpdates(Updates);
+    if (MSSAU) {
+      MSSAU->applyUpdates(Updates, DT);
+      if (VerifyMemorySSA)
+        MSSAU->getMemorySSA()->verifyMemorySSA();
+    }
+    L->moveToHeader(Body);
+    L->removeBlockFromLoop(Header);
+    LI.changeLoopFor(Header, L->getParentLoop());
+    SE.forgetTopmostLoop(L);
+    LLVM_DEBUG(dbgs() << "Ruoto il loop: nuovo header " << Body->getName() << ", esce da "
+                      << Latch->getName() << "\n");
+    return true;
+  }
+
+  // Main entry point, takes IR unit to run the pass on (&L) and the
+  // corresponding pass manager (to be queried if need be). Le analisi di
+  // funzione arrivano gia' calcolate in AR e vanno tenute aggiornate.
+  PreservedAnalyses run(Loop &L, LoopAnalysisManager &AM,
+                        LoopStandardAnalysisResults &AR, LPMUpdater &U) {
 //<<<<<<< HEAD
 
 /* Lab_3
@@ -287,130 +1826,551 @@ struct TestPass: PassInfoMixin<TestPass> {
     
 */
 
-  LoopInfo &LI = AM.getResult<LoopAnalysis>(F);
-  DominatorTree &DT = AM.getResult<DominatorTreeAnalysis>(F);
-  std::map<BasicBlock*,std::pair<std::set<Instruction*>,std::set<Instruction*>>> rd = getReachingDefinitions(F);
-  //Istruzioni Loop-Invariant
-  std::vector<std::pair<Instruction*,Loop*>> LII = getLoopInvariants(LI,rd);
-  std::vector<Instruction *> Candidates;
+  Function &F = *L.getHeader()->getParent();
+  std::unique_ptr<MemorySSAUpdater> MSSAU;
+  if (AR.MSSA)
+    MSSAU = std::make_unique<MemorySSAUpdater>(AR.MSSA);
 
-  std::vector<BasicBlock *> ExitBlocks;
-  for (Loop *L : LI) {
-    for (BasicBlock *BB : L->blocks()) {
-      for (BasicBlock *Succ : successors(BB))
-        if (!L->contains(Succ)) ExitBlocks.push_back(Succ);
+  // Prima della LICM: rotazione e riassociazione per esporre le parti
+  // invarianti
+  bool Changed = false;
+  bool Ruotato = RotateOpt && rotateLoop(&L, AR.DT, AR.LI, AR.SE, MSSAU.get());
+  Changed |= Ruotato;
+  if (ReassociateOpt)
+    Changed |= reassociateLoop(&L, AR.LI, AR.SE);
+  // Le costanti costose finiscono nel preheader; da un loop interno il
+  // bitcast e' invariante anche per i loop esterni e puo' risalire ancora
+  if (ConstHoistOpt)
+    Changed |= hoistConstants(&L, AR.TTI, AR.SE);
+
+  // Le reaching definitions arrivano da LICMLoopsPass. Da solo (es. dentro
+  // loop-mssa(...)) il loop pass le calcola per il proprio loop: in forma
+  // SSA basta il dominator tree di AR, gia' aggiornato.
+  ReachingDefinitions Locali;
+  if (!RDFunzione)
+    Locali = getReachingDefinitions(F, AR.DT);
+  const ReachingDefinitions &RD = RDFunzione ? *RDFunzione : Locali;
+
+  // MemorySSA c'e' solo in una pipeline loop-mssa(...): senza, i load
+  // restano nel loop ma la promozione a registro (solo alias analysis) resta
+  MemorySSA *MSSA = MemoryOpt ? AR.MSSA : nullptr;
+  AAResults *AA = MemoryOpt ? &AR.AA : nullptr;
+
+  // Funzioni pure: analisi di modulo, solo se e' in cache
+  // (require<pure-functions>); altrimenti valgono gli attributi dichiarati
+  PureFunctions SoloAttributi;
+  const PureFunctions *Pure = &SoloAttributi;
+  if (auto *MAMP = AM.getResult<FunctionAnalysisManagerLoopProxy>(L, AR)
+                       .getCachedResult<ModuleAnalysisManagerFunctionProxy>(F))
+    if (auto *Cached = MAMP->getCachedResult<PureFunctionsAnalysis>(*F.getParent()))
+      Pure = Cached;
+
+  // I loop interni sono gia' stati visitati: quello che ne e' uscito si trova
+  // nel loro preheader, dentro L, e puo' risalire ancora
+  HoistPlan Plan;
+  planLoop(&L, AR.DT, RD, MSSA, AA, *Pure, AR.TTI, AR.SE, Plan);
+  Changed |= applyPlan(Plan, AR.DT, AR.LI, AR.SE, MSSAU.get());
+
+  // Promozione a registro: il load e gli store inseriti intorno ai loop
+  // interni possono essere promossi da L
+  if (AA)
+    Changed |= promoteLoop(&L, AR.DT, *AA, MSSAU.get());
+
+  // Sinking: quello che esce da un loop interno puo' uscire anche da L
+  if (SinkOpt)
+    Changed |= sinkLoop(&L, AR.DT, AR.SE);
+
+  if (!Changed)
+    return PreservedAnalyses::all();
+  // L'insieme dei loop non cambia (niente da segnalare a U). Dominator
+  // tree, LoopInfo, scalar evolution e MemorySSA sono aggiornati; il CFG
+  // cambia solo con la rotazione o con una guardia.
+  auto PA = getLoopPassPreservedAnalyses();
+  if (!Ruotato && !Plan.Guardia)
+    PA.preserveSet<CFGAnalyses>();
+  if (AR.MSSA)
+    PA.preserve<MemorySSAAnalysis>();
+  return PA;
+}
+
+  // Without isRequired returning true, this pass will be skipped for functions
+  // decorated with the optnone LLVM attribute. Note that clang -O0 decorates
+  // all functions with optnone.
+  static bool isRequired() { return true; }
+};
+
+// La sola rotazione, come loop pass a se': -passes="loop(licm-loop-rotate)"
+struct RotatePass : PassInfoMixin<RotatePass> {
+  PreservedAnalyses run(Loop &L, LoopAnalysisManager &AM,
+                        LoopStandardAnalysisResults &AR, LPMUpdater &U) {
+    std::unique_ptr<MemorySSAUpdater> MSSAU;
+    if (AR.MSSA)
+      MSSAU = std::make_unique<MemorySSAUpdater>(AR.MSSA);
+    if (!TestPass().rotateLoop(&L, AR.DT, AR.LI, AR.SE, MSSAU.get()))
+      return PreservedAnalyses::all();
+    auto PA = getLoopPassPreservedAnalyses();
+    if (AR.MSSA)
+      PA.preserve<MemorySSAAnalysis>();
+    return PA;
+  }
+
+  static bool isRequired() { return true; }
+};
+
+// Versioning per la LICM. Un loop interno in cui un accesso a indirizzo
+// invariante non si puo' spostare (o promuovere) solo perche' un accesso a
+// un altro puntatore potrebbe fare alias viene duplicato:
+//
+//   preheader: controlli sugli intervalli di indirizzi
+//     sovrapposti -> copia originale (.lver.orig)
+//     separati    -> loop versionato, con metadati alias.scope/noalias
+//
+// Gli accessi vengono raggruppati per oggetto sottostante. L'intervallo di un
+// gruppo e' [min inizio, max fine) dei suoi accessi, calcolato con SCEV: un
+// puntatore invariante occupa [p, p + dim), un AddRec affine con passo
+// costante va dal primo all'ultimo indirizzo (serve il backedge-taken
+// count). Due gruppi vanno controllati se almeno uno scrive e possono fare
+// alias; i metadati dicono all'alias analysis (scoped-noalias) che nel loop
+// versionato non lo fanno, cosi' la LICM che segue sposta load e store.
+//
+// E' un pass di funzione: duplicare un loop cambia il CFG e LoopInfo in modo
+// che MemorySSA non si puo' aggiornare da dentro la pipeline di loop.
+struct VersioningPass : PassInfoMixin<VersioningPass> {
+
+  struct Accesso {
+    Instruction *I;
+    const SCEV *Inizio, *Fine;
+  };
+
+  struct Gruppo {
+    Value *Base;
+    bool Scrive = false;
+    SmallVector<Accesso, 4> Accessi;
+  };
+
+  // Intervallo [Inizio, Fine) degli indirizzi toccati da I nel loop
+  bool intervallo(Instruction *I, Loop *L, ScalarEvolution &SE, const SCEV *BTC,
+                  const DataLayout &DL, Accesso &A)
+  {
+    Value *Ptr = getLoadStorePointerOperand(I);
+    const SCEV *S = SE.getSCEV(Ptr);
+    const SCEV *Dim = SE.getConstant(DL.getIndexType(Ptr->getType()),
+                                     DL.getTypeStoreSize(getLoadStoreType(I)));
+    if (SE.isLoopInvariant(S, L)) {
+      A = {I, S, SE.getAddExpr(S, Dim)};
+      return true;
     }
+    auto *AR = dyn_cast<SCEVAddRecExpr>(S);
+    if (!AR || AR->getLoop() != L || !AR->isAffine() || isa<SCEVCouldNotCompute>(BTC))
+      return false;
+    auto *Passo = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+    if (!Passo || Passo->getAPInt().isZero())
+      return false;
+    const SCEV *Primo = AR->getStart();
+    const SCEV *Ultimo = SE.getAddExpr(
+        Primo, SE.getMulExpr(Passo, SE.getTruncateOrZeroExtend(BTC, Passo->getType())));
+    if (Passo->getAPInt().isNegative())
+      std::swap(Primo, Ultimo);
+    A = {I, Primo, SE.getAddExpr(Ultimo, Dim)};
+    return true;
   }
 
-  errs() << "Numero di loop trovati: " << LII.size() << "\n";
+  bool versionLoop(Loop *L, DominatorTree &DT, LoopInfo &LI, ScalarEvolution &SE,
+                   AAResults &AA)
+  {
+    //Loop in forma normale (LoopSimplifyPass prima di questo pass)
+    if (!L->isInnermost() || !L->isLoopSimplifyForm() || !L->getExitBlock())
+      return false;
+
+    BasicBlock *Preheader = L->getLoopPreheader();
+    const DataLayout &DL = Preheader->getModule()->getDataLayout();
+    const SCEV *BTC = SE.getBackedgeTakenCount(L);
+    //Il backedge-taken count viene espanso nel preheader: niente divisioni
+    //per valori che potrebbero essere zero
+    if (!isa<SCEVCouldNotCompute>(BTC) && SCEVExprContains(BTC, [](const SCEV *X) {
+          auto *D = dyn_cast<SCEVUDivExpr>(X);
+          return D && !isa<SCEVConstant>(D->getRHS());
+        }))
+      return false;
 
-    errs() << "Numero di loop trovati: " << LII.size() << "\n";
-   
-  
-  
-    // Cercare istruzioni candidate
+    //Accessi raggruppati per oggetto sottostante
+    MapVector<Value*, Gruppo> Gruppi;
+    for (BasicBlock *BB : L->blocks())
+      for (Instruction &I : *BB) {
+        if (!I.mayReadOrWriteMemory())
+          continue;
+        bool Semplice = (isa<LoadInst>(I) && cast<LoadInst>(I).isSimple()) ||
+                        (isa<StoreInst>(I) && cast<StoreInst>(I).isSimple());
+        Accesso A;
+        if (!Semplice || !intervallo(&I, L, SE, BTC, DL, A))
+          return false;
+        Value *Base = getUnderlyingObject(getLoadStorePointerOperand(&I));
+        Gruppo &G = Gruppi[Base];
+        G.Base = Base;
+        G.Scrive |= isa<StoreInst>(I);
+        G.Accessi.push_back(A);
+      }
 
-    for (auto &p : LII) {
+    auto possonoFareAlias = [&](const Gruppo &G, const Gruppo &H) {
+      if (!G.Scrive && !H.Scrive)
+        return false;
+      for (const Accesso &A : G.Accessi)
+        for (const Accesso &B : H.Accessi)
+          if ((isa<StoreInst>(A.I) || isa<StoreInst>(B.I)) &&
+              !AA.isNoAlias(MemoryLocation::get(A.I), MemoryLocation::get(B.I)))
+            return true;
+      return false;
+    };
 
-      errs() << "Sono dentro al for che scorre LII\n";
-      Instruction *Inst = p.first;
-      Loop *L = p.second;
-      errs() << "Loop-invariant: " << *Inst << "\n";
-      // Si trovano in blocchi che dominano tutte le uscite del loop
-      bool dom_uscite = true;
-      for (BasicBlock *ExitBB : ExitBlocks) {
-        if (!DT.dominates(Inst->getParent(), ExitBB)) {
-          dom_uscite = false;
-          break;
-        }
+    //Coppie da controllare; serve almeno un accesso a indirizzo invariante
+    //bloccato da un altro gruppo, altrimenti la LICM non ci guadagna
+    SmallVector<std::pair<unsigned, unsigned>, 8> Controlli;
+    bool Utile = false;
+    for (unsigned g = 0; g < Gruppi.size(); g++)
+      for (unsigned h = g + 1; h < Gruppi.size(); h++) {
+        Gruppo &G = Gruppi.begin()[g].second, &H = Gruppi.begin()[h].second;
+        if (!possonoFareAlias(G, H))
+          continue;
+        Controlli.push_back({g, h});
+        for (Gruppo *X : {&G, &H})
+          for (const Accesso &A : X->Accessi)
+            if (SE.isLoopInvariant(SE.getSCEV(getLoadStorePointerOperand(A.I)), L))
+              Utile = true;
       }
-      // Oppure la variabile definita dall’istruzione è dead all’uscita del loop
-      bool dead = true;
-      for (User *U : Inst->users()) { // Scorro gli user dell'istruzione
-        if (Instruction *UserInst = dyn_cast<Instruction>(U)) {
-          if (L->contains(UserInst->getParent())) { // Se è nel loop
-            dead = false;
-            break;
-          }
-        }
+    if (!Utile || Controlli.size() > VersioningMaxChecks)
+      return false;
+
+    //Intervallo di ogni gruppo, espanso nel preheader
+    SCEVExpander Exp(SE, DL, "lver");
+    IRBuilder<> Builder(Preheader->getTerminator());
+    SmallVector<std::pair<Value*, Value*>, 8> Intervalli;
+    for (auto &GP : Gruppi) {
+      Gruppo &G = GP.second;
+      const SCEV *Inizio = G.Accessi.front().Inizio, *Fine = G.Accessi.front().Fine;
+      for (const Accesso &A : G.Accessi) {
+        Inizio = SE.getUMinExpr(Inizio, A.Inizio);
+        Fine = SE.getUMaxExpr(Fine, A.Fine);
       }
-      // Assegnano un valore a variabili non assegnate altrove nel loop
-      bool assegn_unico = true;
-      for (BasicBlock *LoopBB : L->blocks()) {
-        for (Instruction &OtherInst : *LoopBB) {
-          if (&OtherInst != Inst && OtherInst.getName() == Inst->getName()) {
-            assegn_unico = false;
-            break;
-          }
-        }
-        if (!assegn_unico) break;
+      Intervalli.push_back({Exp.expandCodeFor(Inizio, Inizio->getType(), Preheader->getTerminator()),
+                            Exp.expandCodeFor(Fine, Fine->getType(), Preheader->getTerminator())});
+    }
+    Value *Sovrapposti = nullptr;
+    for (auto &C : Controlli) {
+      auto &G = Intervalli[C.first], &H = Intervalli[C.second];
+      Value *Conflitto = Builder.CreateAnd(Builder.CreateICmpULT(G.first, H.second, "lver.gh"),
+                                           Builder.CreateICmpULT(H.first, G.second, "lver.hg"),
+                                           "lver.conflict");
+      Sovrapposti = Sovrapposti ? Builder.CreateOr(Sovrapposti, Conflitto, "lver.any")
+                                : Conflitto;
+    }
+
+    //Duplicazione, come llvm::LoopVersioning: il preheader diventa il
+    //blocco dei controlli, la copia originale va dove i puntatori si
+    //sovrappongono
+    if (!L->isLCSSAForm(DT))
+      formLCSSA(*L, DT, &LI, &SE);
+    BasicBlock *Header = L->getHeader();
+    BasicBlock *Exit = L->getExitBlock();
+    BasicBlock *Check = Preheader;
+    Check->setName(Header->getName() + ".lver.check");
+    BasicBlock *NewPreheader = SplitBlock(Check, Check->getTerminator(), &DT, &LI, nullptr,
+                                          Header->getName() + ".ph");
+    ValueToValueMapTy VMap;
+    SmallVector<BasicBlock*, 8> Blocchi;
+    Loop *Originale = cloneLoopWithPreheader(NewPreheader, Check, L, VMap, ".lver.orig",
+                                             &LI, &DT, Blocchi);
+    remapInstructionsInBlocks(Blocchi, VMap);
+    Instruction *OldTerm = Check->getTerminator();
+    BranchInst::Create(Originale->getLoopPreheader(), NewPreheader, Sovrapposti, OldTerm);
+    OldTerm->eraseFromParent();
+    DT.changeImmediateDominator(Exit, Check);
+
+    //I PHI LCSSA dell'uscita ricevono anche i valori della copia
+    for (PHINode &PN : Exit->phis())
+      for (unsigned k = 0, e = PN.getNumIncomingValues(); k < e; k++) {
+        BasicBlock *Pred = PN.getIncomingBlock(k);
+        if (!L->contains(Pred))
+          continue;
+        Value *V = PN.getIncomingValue(k);
+        auto It = VMap.find(V);
+        PN.addIncoming(It == VMap.end() ? V : static_cast<Value*>(It->second),
+                       cast<BasicBlock>(VMap[Pred]));
       }
-      // Si trovano in blocchi che dominano tutti i blocchi nel loop che usano la variabile a cui si sta assegnando un valore
-      bool dom_all_b = true;
-      for (BasicBlock *LoopBB : L->blocks()) {
-        if (!DT.dominates(Inst->getParent(), LoopBB)) {
-          dom_all_b = false;
-          break;
-        }
+    formDedicatedExitBlocks(Originale, &DT, &LI, nullptr, true);
+    formDedicatedExitBlocks(L, &DT, &LI, nullptr, true);
+
+    //Metadati di alias nel loop versionato: uno scope per gruppo, noalias
+    //verso i gruppi controllati
+    LLVMContext &Ctx = Header->getContext();
+    MDBuilder MDB(Ctx);
+    MDNode *Dominio = MDB.createAnonymousAliasScopeDomain("lver");
+    SmallVector<MDNode*, 8> Scope;
+    for (auto &GP : Gruppi)
+      Scope.push_back(MDB.createAnonymousAliasScope(Dominio, GP.first->getName()));
+    for (unsigned g = 0; g < Gruppi.size(); g++) {
+      SmallVector<Metadata*, 8> NoAlias;
+      for (auto &C : Controlli)
+        if (C.first == g || C.second == g)
+          NoAlias.push_back(Scope[C.first == g ? C.second : C.first]);
+      if (NoAlias.empty())
+        continue;
+      MDNode *ScopeList = MDNode::get(Ctx, {Scope[g]});
+      MDNode *NoAliasList = MDNode::get(Ctx, NoAlias);
+      for (const Accesso &A : Gruppi.begin()[g].second.Accessi) {
+        A.I->setMetadata(LLVMContext::MD_alias_scope,
+                         MDNode::concatenate(A.I->getMetadata(LLVMContext::MD_alias_scope), ScopeList));
+        A.I->setMetadata(LLVMContext::MD_noalias,
+                         MDNode::concatenate(A.I->getMetadata(LLVMContext::MD_noalias), NoAliasList));
       }
-      
-      errs() << "Istr: " << *Inst << "\n";
-      errs() << "\t dom_uscite: " << dom_uscite << "\n";
-      errs() << "\t dead: " << dead << "\n";
-      errs() << "\t assegn_unico: " << assegn_unico << "\n";
-      errs() << "\t dom_all_b: " << dom_all_b << "\n";
+    }
 
-      // Se tutte le condizioni sono soddisfatte, l'istruzione è candidata per essere spostata
-      if (dom_uscite && (dead || assegn_unico) && dom_all_b) Candidates.push_back(Inst);
+    SE.forgetLoop(L);
+    LLVM_DEBUG(dbgs() << "Versiono il loop " << Header->getName() << ": " << Controlli.size()
+                      << " controlli di alias in " << Check->getName() << "\n");
+    return true;
+  }
+
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM) {
+    if (!VersioningOpt)
+      return PreservedAnalyses::all();
+    LoopInfo &LI = AM.getResult<LoopAnalysis>(F);
+    DominatorTree &DT = AM.getResult<DominatorTreeAnalysis>(F);
+    ScalarEvolution &SE = AM.getResult<ScalarEvolutionAnalysis>(F);
+    AAResults &AA = AM.getResult<AAManager>(F);
+
+    bool Changed = false;
+    for (Loop *L : LI.getLoopsInPreorder())
+      if (L->isInnermost())
+        Changed |= versionLoop(L, DT, LI, SE, AA);
+
+    if (!Changed)
+      return PreservedAnalyses::all();
+    PreservedAnalyses PA;
+    PA.preserve<DominatorTreeAnalysis>();
+    PA.preserve<LoopAnalysis>();
+    return PA;
+  }
+
+  static bool isRequired() { return true; }
+};
+
+// Unswitching: un branch del loop su una condizione invariante esegue ad
+// ogni iterazione e impedisce di spostare le istruzioni dei due rami, che
+// non dominano il latch. Il loop viene duplicato (come nel versioning), il
+// preheader sceglie la copia con la condizione e in ciascuna copia il branch
+// diventa un salto incondizionato. L'invarianza e' quella della LICM
+// (getLoopInvariants): una condizione calcolata nel loop viene spostata nel
+// preheader se tutta la catena e' speculabile.
+struct UnswitchPass : PassInfoMixin<UnswitchPass> {
+
+  // Le istruzioni del loop da cui dipende la condizione, nell'ordine di
+  // getLoopInvariants; false se qualcuna non e' invariante o speculabile
+  bool catenaInvariante(Value *Cond, Loop *L, const std::vector<Instruction*> &LII,
+                        const SmallPtrSetImpl<Instruction*> &Invarianti,
+                        SmallVectorImpl<Instruction*> &Catena)
+  {
+    SmallPtrSet<Instruction*, 8> Servono;
+    SmallVector<Instruction*, 8> Worklist;
+    auto aggiungi = [&](Value *V) {
+      if (auto *I = dyn_cast<Instruction>(V))
+        if (L->contains(I) && Servono.insert(I).second)
+          Worklist.push_back(I);
+    };
+    aggiungi(Cond);
+    while (!Worklist.empty()) {
+      Instruction *I = Worklist.pop_back_val();
+      if (!isSafeToSpeculativelyExecute(I) || !Invarianti.count(I))
+        return false;
+      for (Value *Op : I->operands())
+        aggiungi(Op);
     }
+    for (Instruction *I : LII)
+      if (Servono.count(I))
+        Catena.push_back(I);
+    return true;
+  }
 
+  // Il primo branch condizionato di L su una condizione invariante
+  BranchInst *cercaBranch(Loop *L, const ReachingDefinitions &RD,
+                          SmallVectorImpl<Instruction*> &Catena)
+  {
+    HoistPlan Plan;
+    PureFunctions SoloAttributi;
+    std::vector<Instruction*> LII =
+        TestPass().getLoopInvariants(L, RD, Plan, nullptr, nullptr, SoloAttributi);
+    SmallPtrSet<Instruction*, 16> Invarianti(LII.begin(), LII.end());
+    for (BasicBlock *BB : L->blocks()) {
+      auto *BI = dyn_cast<BranchInst>(BB->getTerminator());
+      if (!BI || !BI->isConditional() || isa<Constant>(BI->getCondition()) ||
+          BI->getSuccessor(0) == BI->getSuccessor(1))
+        continue;
+      Catena.clear();
+      if (catenaInvariante(BI->getCondition(), L, LII, Invarianti, Catena))
+        return BI;
+    }
+    return nullptr;
+  }
 
+  void unswitchLoop(Loop *L, BranchInst *BI, ArrayRef<Instruction*> Catena,
+                    DominatorTree &DT, LoopInfo &LI)
+  {
+    BasicBlock *Preheader = L->getLoopPreheader();
+    BasicBlock *Header = L->getHeader();
+    LLVM_DEBUG(dbgs() << "Unswitch del loop " << Header->getName() << " su "
+                      << *BI->getCondition() << "\n");
+    for (Instruction *I : Catena)
+      I->moveBefore(Preheader->getTerminator());
+    formLCSSARecursively(*L, DT, &LI, nullptr);
 
+    SmallVector<BasicBlock*, 4> Uscite;
+    L->getUniqueExitBlocks(Uscite);
+    BasicBlock *NewPreheader = SplitBlock(Preheader, Preheader->getTerminator(), &DT, &LI, nullptr,
+                                          Header->getName() + ".ph");
+    ValueToValueMapTy VMap;
+    SmallVector<BasicBlock*, 8> Blocchi;
+    Loop *Falso = cloneLoopWithPreheader(NewPreheader, Preheader, L, VMap, ".us.f",
+                                         &LI, &DT, Blocchi);
+    remapInstructionsInBlocks(Blocchi, VMap);
 
+    //I PHI delle uscite ricevono anche i valori della copia
+    for (BasicBlock *Exit : Uscite)
+      for (PHINode &PN : Exit->phis())
+        for (unsigned k = 0, e = PN.getNumIncomingValues(); k < e; k++) {
+          BasicBlock *Pred = PN.getIncomingBlock(k);
+          if (!L->contains(Pred))
+            continue;
+          Value *V = PN.getIncomingValue(k);
+          auto It = VMap.find(V);
+          PN.addIncoming(It == VMap.end() ? V : static_cast<Value*>(It->second),
+                         cast<BasicBlock>(VMap[Pred]));
+        }
 
+    //In ciascuna copia la condizione e' nota: ogni suo uso nel loop (non
+    //solo il branch) diventa una costante
+    Value *Cond = BI->getCondition();
+    Cond->replaceUsesWithIf(ConstantInt::getTrue(Cond->getType()), [&](Use &U) {
+      auto *I = dyn_cast<Instruction>(U.getUser());
+      return I && L->contains(I);
+    });
+    Cond->replaceUsesWithIf(ConstantInt::getFalse(Cond->getType()), [&](Use &U) {
+      auto *I = dyn_cast<Instruction>(U.getUser());
+      return I && Falso->contains(I);
+    });
 
-    // Eseguire una ricerca depth-first dei blocch
-    std::vector<BasicBlock*> BBOrdinatiDFS;
-    for (BasicBlock *BB : llvm::depth_first(&F.getEntryBlock()))
-      BBOrdinatiDFS.push_back(BB);
+    //Il preheader sceglie la copia. Il branch originale poteva non essere
+    //mai raggiunto: una condizione poison o undef va congelata, altrimenti
+    //il branch nel preheader sarebbe undefined behaviour
+    Instruction *OldTerm = Preheader->getTerminator();
+    if (!isGuaranteedNotToBeUndefOrPoison(Cond, nullptr, OldTerm, &DT))
+      Cond = new FreezeInst(Cond, Cond->getName() + ".fr", OldTerm);
+    BranchInst::Create(NewPreheader, Falso->getLoopPreheader(), Cond, OldTerm);
+    OldTerm->eraseFromParent();
 
-    // Spostare l’istruzione candidata nel preheader se tutte le istruzioni invarianti da cui questa dipende sono state spostate
-    for (auto *L : LI) {
-      BasicBlock *Preheader = L->getLoopPreheader();
-      if (Preheader) {
-        std::vector<Instruction*> moved; // per istruzioni già spostate
-        for (Instruction *Inst : Candidates) {
-          bool tutteSpostate = true;
-          for (Use &U : Inst->operands())
-            // Se trovo una che non è ancora stata spostata
-            if (Instruction *OpInst = dyn_cast<Instruction>(U.get()))
-              if (std::find(Candidates.begin(), Candidates.end(), OpInst) != Candidates.end() &&
-                  std::find(moved.begin(), moved.end(), OpInst) == moved.end()) {
-                  tutteSpostate = false;
-                  break;
-              }     
-          if (tutteSpostate) {
-            errs() << "Sposto: " << *Inst << " nel preheader\n";
-            Inst->moveBefore(Preheader->getTerminator());
-            moved.push_back(Inst);
-          }
+    //In ciascuna copia il branch prende sempre lo stesso ramo
+    auto fissa = [](BranchInst *B, unsigned Preso) {
+      BasicBlock *Scartato = B->getSuccessor(1 - Preso);
+      Scartato->removePredecessor(B->getParent());
+      BranchInst::Create(B->getSuccessor(Preso), B);
+      B->eraseFromParent();
+    };
+    BranchInst *BIFalso = cast<BranchInst>(VMap[BI]);
+    fissa(BI, 0);
+    fissa(BIFalso, 1);
+  }
+
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM) {
+    if (!UnswitchOpt)
+      return PreservedAnalyses::all();
+    LoopInfo &LI = AM.getResult<LoopAnalysis>(F);
+    DominatorTree &DT = AM.getResult<DominatorTreeAnalysis>(F);
+
+    //Dominator tree e loop vengono aggiornati sul posto; le altre analisi
+    //(anche le reaching definitions dense) non valgono piu'. Quelle in forma
+    //SSA dipendono solo dal dominator tree e restano in cache.
+    PreservedAnalyses Aggiornate;
+    Aggiornate.preserve<DominatorTreeAnalysis>();
+    Aggiornate.preserve<LoopAnalysis>();
+
+    //Un unswitch per giro: i rami fissati lasciano blocchi irraggiungibili,
+    //quindi dominator tree e loop vengono ricalcolati prima del successivo
+    unsigned Budget = UnswitchBudget;
+    for (bool Fatto = true; Fatto;) {
+      Fatto = false;
+      bool Semplificato = false;
+      for (Loop *L : LI)
+        Semplificato |= simplifyLoop(L, &DT, &LI, nullptr, nullptr, nullptr,
+                                     /*PreserveLCSSA=*/false);
+      if (Semplificato)
+        AM.invalidate(F, Aggiornate);
+      const ReachingDefinitions &RD = AM.getResult<ReachingDefinitionsAnalysis>(F);
+      for (Loop *L : LI.getLoopsInPreorder()) {
+        if (!L->isLoopSimplifyForm())
+          continue;
+        unsigned Dimensione = 0;
+        for (BasicBlock *BB : L->blocks())
+          Dimensione += BB->size();
+        if (Dimensione > Budget)
+          continue;
+        SmallVector<Instruction*, 8> Catena;
+        if (BranchInst *BI = cercaBranch(L, RD, Catena)) {
+          unswitchLoop(L, BI, Catena, DT, LI);
+          Budget -= Dimensione;
+          Fatto = true;
+          break;
         }
       }
+      if (Fatto) {
+        removeUnreachableBlocks(F);
+        DT.recalculate(F);
+        LI.releaseMemory();
+        LI.analyze(DT);
+        AM.invalidate(F, Aggiornate);
+      }
     }
-    
-  
-
 
+    //Ogni modifica e' gia' stata seguita da AM.invalidate: quello che e'
+    //in cache, comprese le reaching definitions dell'ultimo giro, e' valido
+    return PreservedAnalyses::all();
+  }
 
+  static bool isRequired() { return true; }
+};
 
-  	return PreservedAnalyses::all();
-}
+// Il loop pass su tutti i loop di una funzione, con le reaching definitions
+// di ReachingDefinitionsAnalysis invece che ricalcolate per ogni loop.
+// Nell'IR non SSA restano quelle di prima della LICM: i blocchi creati dopo
+// non hanno informazioni (reachesIn risponde di no). In forma SSA
+// interrogano il dominator tree, che i loop pass tengono aggiornato.
+//
+// L'adaptor porta i loop in forma LoopSimplify/LCSSA e, se cambia l'IR,
+// invalida le analisi di funzione mentre il loop pass ne tiene un
+// riferimento: la forma canonica viene imposta prima di chiedere il
+// risultato, cosi' per l'adaptor non resta niente da fare.
+struct LICMLoopsPass : PassInfoMixin<LICMLoopsPass> {
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM) {
+    FunctionPassManager Canonica;
+    Canonica.addPass(LoopSimplifyPass());
+    Canonica.addPass(LCSSAPass());
+    PreservedAnalyses PA = Canonica.run(F, AM);
+    TestPass LICM;
+    LICM.RDFunzione = &AM.getResult<ReachingDefinitionsAnalysis>(F);
+    PA.intersect(createFunctionToLoopPassAdaptor(std::move(LICM), /*UseMemorySSA=*/true)
+                     .run(F, AM));
+    return PA;
+  }
 
-  // Without isRequired returning true, this pass will be skipped for functions
-  // decorated with the optnone LLVM attribute. Note that clang -O0 decorates
-  // all functions with optnone.
   static bool isRequired() { return true; }
 };
+
+// Pipeline completa della LICM su una funzione: forma normale dei loop,
+// unswitching, versioning, poi il loop pass con MemorySSA
+void addLICMPipeline(FunctionPassManager &FPM)
+{
+  FPM.addPass(LoopSimplifyPass());
+  FPM.addPass(UnswitchPass());
+  FPM.addPass(VersioningPass());
+  FPM.addPass(LICMLoopsPass());
+}
 } // namespace
 
 //-----------------------------------------------------------------------------
@@ -419,11 +2379,63 @@ struct TestPass: PassInfoMixin<TestPass> {
 llvm::PassPluginLibraryInfo getTestPassPluginInfo() {
   return {LLVM_PLUGIN_API_VERSION, "TestPass", LLVM_VERSION_STRING,
           [](PassBuilder &PB) {
+            PB.registerAnalysisRegistrationCallback(
+                [](FunctionAnalysisManager &FAM) {
+                  FAM.registerPass([] { return ReachingDefinitionsAnalysis(); });
+                });
+            PB.registerAnalysisRegistrationCallback(
+                [](ModuleAnalysisManager &MAM) {
+                  MAM.registerPass([] { return PureFunctionsAnalysis(); });
+                });
+            // Sul modulo: calcola prima le funzioni pure
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, ModulePassManager &MPM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                  if (Name == "require<pure-functions>") {
+                    MPM.addPass(RequireAnalysisPass<PureFunctionsAnalysis, Module>());
+                    return true;
+                  }
+                  if (Name == "invalidate<pure-functions>") {
+                    MPM.addPass(InvalidateAnalysisPass<PureFunctionsAnalysis>());
+                    return true;
+                  }
+                  if (Name == "loop-invariant_code_motion_opts") {
+                    FunctionPassManager FPM;
+                    addLICMPipeline(FPM);
+                    MPM.addPass(RequireAnalysisPass<PureFunctionsAnalysis, Module>());
+                    MPM.addPass(createModuleToFunctionPassAdaptor(std::move(FPM)));
+                    return true;
+                  }
+                  return false;
+                });
+            // Dentro una pipeline di loop: loop-mssa(loop-invariant_code_motion_opts)
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, LoopPassManager &LPM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                  if (Name == "loop-invariant_code_motion_opts") {
+                    LPM.addPass(TestPass());
+                    return true;
+                  }
+                  if (Name == "licm-loop-rotate") {
+                    LPM.addPass(RotatePass());
+                    return true;
+                  }
+                  return false;
+                });
+            // Su una funzione: tutta la pipeline, oppure solo unswitching o versioning
             PB.registerPipelineParsingCallback(
                 [](StringRef Name, FunctionPassManager &FPM,
                    ArrayRef<PassBuilder::PipelineElement>) {
                   if (Name == "loop-invariant_code_motion_opts") {
-                    FPM.addPass(TestPass());
+                    addLICMPipeline(FPM);
+                    return true;
+                  }
+                  if (Name == "licm-loop-versioning") {
+                    FPM.addPass(VersioningPass());
+                    return true;
+                  }
+                  if (Name == "licm-loop-unswitch") {
+                    FPM.addPass(UnswitchPass());
                     return true;
                   }
                   return false;
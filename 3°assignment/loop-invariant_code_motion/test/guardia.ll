@@ -0,0 +1,67 @@
+; guardia.ll: una sdiv invariante eseguita ad ogni iterazione di un loop
+; con trip count simbolico. Puo' essere spostata solo se il corpo viene
+; eseguito almeno una volta.
+; @ruotato: il loop controlla la condizione nell'header; la rotazione lo
+; trasforma in un do-while protetto da una guardia e la sdiv va nel
+; preheader.
+; @chiamata_prima: prima della sdiv c'e' una chiamata che puo' non
+; ritornare, la sdiv resta nel loop.
+; @chiamata_dopo: la sdiv viene prima della chiamata nell'header, viene
+; spostata.
+declare void @forse_esce(i32)
+
+define i32 @ruotato(i32 %a, i32 %b, i32 %n) {
+entry:
+  br label %header
+
+header:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %body ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %body ]
+  %c = icmp slt i32 %i, %n
+  br i1 %c, label %body, label %exit
+
+body:
+  %d = sdiv i32 %a, %b
+  %s.next = add i32 %s, %d
+  %i.next = add nsw i32 %i, 1
+  br label %header
+
+exit:
+  ret i32 %s
+}
+
+define i32 @chiamata_prima(i32 %a, i32 %b, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  call void @forse_esce(i32 %i)
+  %d = sdiv i32 %a, %b
+  %s.next = add i32 %s, %d
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %s.next
+}
+
+define i32 @chiamata_dopo(i32 %a, i32 %b, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %d = sdiv i32 %a, %b
+  call void @forse_esce(i32 %i)
+  %s.next = add i32 %s, %d
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %s.next
+}
@@ -0,0 +1,71 @@
+; ModuleID = '../test/guardia.ll'
+source_filename = "../test/guardia.ll"
+
+declare void @forse_esce(i32)
+
+define i32 @ruotato(i32 %a, i32 %b, i32 %n) {
+entry:
+  %c.guard = icmp slt i32 0, %n
+  br i1 %c.guard, label %header.ph, label %exit
+
+header.ph:                                        ; preds = %entry
+  br label %header
+
+header:                                           ; preds = %header.ph
+  %d = sdiv i32 %a, %b
+  br label %body
+
+body:                                             ; preds = %header, %body
+  %s.body = phi i32 [ 0, %header ], [ %s.next, %body ]
+  %i.body = phi i32 [ 0, %header ], [ %i.next, %body ]
+  %s.next = add i32 %s.body, %d
+  %i.next = add nsw i32 %i.body, 1
+  %c.rot = icmp slt i32 %i.next, %n
+  br i1 %c.rot, label %body, label %exit.loopexit
+
+exit.loopexit:                                    ; preds = %body
+  %s.lcssa.ph = phi i32 [ %s.next, %body ]
+  br label %exit
+
+exit:                                             ; preds = %entry, %exit.loopexit
+  %s.lcssa = phi i32 [ %s.lcssa.ph, %exit.loopexit ], [ 0, %entry ]
+  ret i32 %s.lcssa
+}
+
+define i32 @chiamata_prima(i32 %a, i32 %b, i32 %n) {
+entry:
+  br label %loop
+
+loop:                                             ; preds = %loop, %entry
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  call void @forse_esce(i32 %i)
+  %d = sdiv i32 %a, %b
+  %s.next = add i32 %s, %d
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:                                             ; preds = %loop
+  %s.next.lcssa = phi i32 [ %s.next, %loop ]
+  ret i32 %s.next.lcssa
+}
+
+define i32 @chiamata_dopo(i32 %a, i32 %b, i32 %n) {
+entry:
+  %d = sdiv i32 %a, %b
+  br label %loop
+
+loop:                                             ; preds = %loop, %entry
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  call void @forse_esce(i32 %i)
+  %s.next = add i32 %s, %d
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:                                             ; preds = %loop
+  %s.next.lcssa = phi i32 [ %s.next, %loop ]
+  ret i32 %s.next.lcssa
+}
@@ -0,0 +1,53 @@
+; guardia_zero_trip.ll: come guardia.ll ma con -licm-rotate=false -licm-guard.
+; @guardia: il loop esce solo dall'header. Una guardia nel preheader salta
+; il loop quando non farebbe iterazioni e la sdiv viene spostata dopo la
+; guardia.
+; @due_uscite: il loop puo' uscire anche dal corpo verso un altro blocco.
+; La guardia copre solo l'uscita dall'header, quindi non la si inserisce e
+; la sdiv resta nel loop.
+define i32 @guardia(i32 %a, i32 %b, i32 %n) {
+entry:
+  br label %header
+
+header:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %body ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %body ]
+  %c = icmp slt i32 %i, %n
+  br i1 %c, label %body, label %exit
+
+body:
+  %d = sdiv i32 %a, %b
+  %s.next = add i32 %s, %d
+  %i.next = add nsw i32 %i, 1
+  br label %header
+
+exit:
+  ret i32 %s
+}
+
+define i32 @due_uscite(i32 %a, i32 %b, i32 %n, i32 %m) {
+entry:
+  br label %header
+
+header:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %latch ]
+  %c = icmp slt i32 %i, %n
+  br i1 %c, label %body, label %exit
+
+body:
+  %e = icmp eq i32 %i, %m
+  br i1 %e, label %trovato, label %latch
+
+latch:
+  %d = sdiv i32 %a, %b
+  %s.next = add i32 %s, %d
+  %i.next = add nsw i32 %i, 1
+  br label %header
+
+exit:
+  ret i32 %s
+
+trovato:
+  ret i32 -1
+}
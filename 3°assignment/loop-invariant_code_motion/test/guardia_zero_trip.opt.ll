@@ -0,0 +1,59 @@
+; ModuleID = '../test/guardia_zero_trip.ll'
+source_filename = "../test/guardia_zero_trip.ll"
+
+define i32 @guardia(i32 %a, i32 %b, i32 %n) {
+entry:
+  %c.guard = icmp slt i32 0, %n
+  br i1 %c.guard, label %header.ph, label %exit
+
+header.ph:                                        ; preds = %entry
+  %d = sdiv i32 %a, %b
+  br label %header
+
+header:                                           ; preds = %body, %header.ph
+  %i = phi i32 [ 0, %header.ph ], [ %i.next, %body ]
+  %s = phi i32 [ 0, %header.ph ], [ %s.next, %body ]
+  %c = icmp slt i32 %i, %n
+  br i1 %c, label %body, label %exit.loopexit
+
+body:                                             ; preds = %header
+  %s.next = add i32 %s, %d
+  %i.next = add nsw i32 %i, 1
+  br label %header
+
+exit.loopexit:                                    ; preds = %header
+  %s.lcssa.ph = phi i32 [ %s, %header ]
+  br label %exit
+
+exit:                                             ; preds = %entry, %exit.loopexit
+  %s.lcssa = phi i32 [ %s.lcssa.ph, %exit.loopexit ], [ 0, %entry ]
+  ret i32 %s.lcssa
+}
+
+define i32 @due_uscite(i32 %a, i32 %b, i32 %n, i32 %m) {
+entry:
+  br label %header
+
+header:                                           ; preds = %latch, %entry
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %latch ]
+  %c = icmp slt i32 %i, %n
+  br i1 %c, label %body, label %exit
+
+body:                                             ; preds = %header
+  %e = icmp eq i32 %i, %m
+  br i1 %e, label %trovato, label %latch
+
+latch:                                            ; preds = %body
+  %d = sdiv i32 %a, %b
+  %s.next = add i32 %s, %d
+  %i.next = add nsw i32 %i, 1
+  br label %header
+
+exit:                                             ; preds = %header
+  %s.lcssa = phi i32 [ %s, %header ]
+  ret i32 %s.lcssa
+
+trovato:                                          ; preds = %body
+  ret i32 -1
+}
@@ -0,0 +1,61 @@
+; promozione.ll: accessi a memoria nel loop.
+; @promossa: load e store di @G ad ogni iterazione. La locazione viene
+; promossa a registro: un load nel preheader e uno store all'uscita.
+; @load_invariante: il load di %p non e' scritto nel loop e viene spostato.
+; @chiamata: la chiamata puo' leggere e scrivere @G, niente promozione.
+@G = global i32 0
+
+declare void @sconosciuta()
+
+define void @promossa(i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %v = load i32, ptr @G
+  %v.next = add i32 %v, %i
+  store i32 %v.next, ptr @G
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+define i32 @load_invariante(ptr noalias %p, ptr noalias %out, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %x = load i32, ptr %p
+  %ie = sext i32 %i to i64
+  %o = getelementptr inbounds i32, ptr %out, i64 %ie
+  store i32 %x, ptr %o
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %x
+}
+
+define void @chiamata(i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %v = load i32, ptr @G
+  %v.next = add i32 %v, %i
+  store i32 %v.next, ptr @G
+  call void @sconosciuta()
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,62 @@
+; ModuleID = '../test/promozione.ll'
+source_filename = "../test/promozione.ll"
+
+@G = global i32 0
+
+declare void @sconosciuta()
+
+define void @promossa(i32 %n) {
+entry:
+  %G.promoted = load i32, ptr @G, align 4
+  br label %loop
+
+loop:                                             ; preds = %loop, %entry
+  %v1 = phi i32 [ %G.promoted, %entry ], [ %v.next, %loop ]
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %v.next = add i32 %v1, %i
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:                                             ; preds = %loop
+  %v.next.lcssa = phi i32 [ %v.next, %loop ]
+  store i32 %v.next.lcssa, ptr @G, align 4
+  ret void
+}
+
+define i32 @load_invariante(ptr noalias %p, ptr noalias %out, i32 %n) {
+entry:
+  %x = load i32, ptr %p, align 4
+  br label %loop
+
+loop:                                             ; preds = %loop, %entry
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %ie = sext i32 %i to i64
+  %o = getelementptr inbounds i32, ptr %out, i64 %ie
+  store i32 %x, ptr %o, align 4
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:                                             ; preds = %loop
+  %x.lcssa = phi i32 [ %x, %loop ]
+  ret i32 %x.lcssa
+}
+
+define void @chiamata(i32 %n) {
+entry:
+  br label %loop
+
+loop:                                             ; preds = %loop, %entry
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %v = load i32, ptr @G, align 4
+  %v.next = add i32 %v, %i
+  store i32 %v.next, ptr @G, align 4
+  call void @sconosciuta()
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:                                             ; preds = %loop
+  ret void
+}
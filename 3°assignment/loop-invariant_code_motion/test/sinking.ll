@@ -0,0 +1,35 @@
+; sinking.ll: valori calcolati nel loop.
+; @usato_dopo: %m dipende dall'iterazione ed e' usato solo dopo il loop,
+; viene spostato nell'uscita e calcolato una volta sola.
+; @usato_dentro: %m e' usato anche nel loop, resta dov'e'.
+define i32 @usato_dopo(i32 %a, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %m = mul i32 %i, %a
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %m
+}
+
+define i32 @usato_dentro(i32 %a, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %m = mul i32 %i, %a
+  %s.next = add i32 %s, %m
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %m
+}
@@ -0,0 +1,36 @@
+; ModuleID = '../test/sinking.ll'
+source_filename = "../test/sinking.ll"
+
+define i32 @usato_dopo(i32 %a, i32 %n) {
+entry:
+  br label %loop
+
+loop:                                             ; preds = %loop, %entry
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:                                             ; preds = %loop
+  %i.lcssa = phi i32 [ %i, %loop ]
+  %m = mul i32 %i.lcssa, %a
+  ret i32 %m
+}
+
+define i32 @usato_dentro(i32 %a, i32 %n) {
+entry:
+  br label %loop
+
+loop:                                             ; preds = %loop, %entry
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %m = mul i32 %i, %a
+  %s.next = add i32 %s, %m
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:                                             ; preds = %loop
+  %m.lcssa = phi i32 [ %m, %loop ]
+  ret i32 %m.lcssa
+}
@@ -0,0 +1,57 @@
+; speculazione.ll: istruzioni invarianti in un ramo del loop, che non
+; domina il latch. Con -licm-speculate:
+; @economica: la mul costa poco e non puo' fallire, viene spostata nel
+; preheader anche se il ramo non viene sempre eseguito.
+; @divisione: la sdiv puo' dividere per zero proprio quando il ramo non
+; viene eseguito, resta nel loop.
+define i32 @economica(i32 %a, i32 %b, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %latch ]
+  %pari = and i32 %i, 1
+  %c = icmp eq i32 %pari, 0
+  br i1 %c, label %then, label %latch
+
+then:
+  %m = mul i32 %a, %b
+  %t = add i32 %s, %m
+  br label %latch
+
+latch:
+  %s.next = phi i32 [ %t, %then ], [ %s, %loop ]
+  %i.next = add nsw i32 %i, 1
+  %cond = icmp slt i32 %i.next, %n
+  br i1 %cond, label %loop, label %exit
+
+exit:
+  ret i32 %s.next
+}
+
+define i32 @divisione(i32 %a, i32 %b, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %latch ]
+  %pari = and i32 %i, 1
+  %c = icmp eq i32 %pari, 0
+  br i1 %c, label %then, label %latch
+
+then:
+  %d = sdiv i32 %a, %b
+  %t = add i32 %s, %d
+  br label %latch
+
+latch:
+  %s.next = phi i32 [ %t, %then ], [ %s, %loop ]
+  %i.next = add nsw i32 %i, 1
+  %cond = icmp slt i32 %i.next, %n
+  br i1 %cond, label %loop, label %exit
+
+exit:
+  ret i32 %s.next
+}
@@ -0,0 +1,56 @@
+; ModuleID = '../test/speculazione.ll'
+source_filename = "../test/speculazione.ll"
+
+define i32 @economica(i32 %a, i32 %b, i32 %n) {
+entry:
+  %m = mul i32 %a, %b
+  br label %loop
+
+loop:                                             ; preds = %latch, %entry
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %latch ]
+  %pari = and i32 %i, 1
+  %c = icmp eq i32 %pari, 0
+  br i1 %c, label %then, label %latch
+
+then:                                             ; preds = %loop
+  %t = add i32 %s, %m
+  br label %latch
+
+latch:                                            ; preds = %then, %loop
+  %s.next = phi i32 [ %t, %then ], [ %s, %loop ]
+  %i.next = add nsw i32 %i, 1
+  %cond = icmp slt i32 %i.next, %n
+  br i1 %cond, label %loop, label %exit
+
+exit:                                             ; preds = %latch
+  %s.next.lcssa = phi i32 [ %s.next, %latch ]
+  ret i32 %s.next.lcssa
+}
+
+define i32 @divisione(i32 %a, i32 %b, i32 %n) {
+entry:
+  br label %loop
+
+loop:                                             ; preds = %latch, %entry
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %latch ]
+  %pari = and i32 %i, 1
+  %c = icmp eq i32 %pari, 0
+  br i1 %c, label %then, label %latch
+
+then:                                             ; preds = %loop
+  %d = sdiv i32 %a, %b
+  %t = add i32 %s, %d
+  br label %latch
+
+latch:                                            ; preds = %then, %loop
+  %s.next = phi i32 [ %t, %then ], [ %s, %loop ]
+  %i.next = add nsw i32 %i, 1
+  %cond = icmp slt i32 %i.next, %n
+  br i1 %cond, label %loop, label %exit
+
+exit:                                             ; preds = %latch
+  %s.next.lcssa = phi i32 [ %s.next, %latch ]
+  ret i32 %s.next.lcssa
+}
@@ -0,0 +1,70 @@
+; unswitch.ll: branch nel loop.
+; @invariante: la condizione %k > 5 non cambia nel loop. Il loop viene
+; duplicato e il preheader sceglie la copia: in ciascuna il branch diventa
+; un salto incondizionato.
+; @variante: la condizione dipende da %i, il loop resta com'e'.
+define void @invariante(ptr %a, i32 %n, i32 %k) {
+entry:
+  br label %h
+
+h:
+  %i = phi i32 [ 0, %entry ], [ %i.n, %l ]
+  %c = icmp slt i32 %i, %n
+  br i1 %c, label %body, label %e
+
+body:
+  %t = icmp sgt i32 %k, 5
+  br i1 %t, label %x, label %y
+
+x:
+  %ie = sext i32 %i to i64
+  %p = getelementptr i32, ptr %a, i64 %ie
+  store i32 1, ptr %p
+  br label %l
+
+y:
+  %ye = sext i32 %i to i64
+  %q = getelementptr i32, ptr %a, i64 %ye
+  store i32 2, ptr %q
+  br label %l
+
+l:
+  %i.n = add i32 %i, 1
+  br label %h
+
+e:
+  ret void
+}
+
+define void @variante(ptr %a, i32 %n, i32 %k) {
+entry:
+  br label %h
+
+h:
+  %i = phi i32 [ 0, %entry ], [ %i.n, %l ]
+  %c = icmp slt i32 %i, %n
+  br i1 %c, label %body, label %e
+
+body:
+  %t = icmp sgt i32 %i, %k
+  br i1 %t, label %x, label %y
+
+x:
+  %ie = sext i32 %i to i64
+  %p = getelementptr i32, ptr %a, i64 %ie
+  store i32 1, ptr %p
+  br label %l
+
+y:
+  %ye = sext i32 %i to i64
+  %q = getelementptr i32, ptr %a, i64 %ye
+  store i32 2, ptr %q
+  br label %l
+
+l:
+  %i.n = add i32 %i, 1
+  br label %h
+
+e:
+  ret void
+}
@@ -0,0 +1,114 @@
+; ModuleID = '../test/unswitch.ll'
+source_filename = "../test/unswitch.ll"
+
+define void @invariante(ptr %a, i32 %n, i32 %k) {
+entry:
+  %t = icmp sgt i32 %k, 5
+  %t.fr = freeze i1 %t
+  br i1 %t.fr, label %h.ph, label %h.ph.us.f
+
+h.ph.us.f:                                        ; preds = %entry
+  %c.us.f.guard = icmp slt i32 0, %n
+  br i1 %c.us.f.guard, label %h.us.f.ph, label %e.loopexit1
+
+h.us.f.ph:                                        ; preds = %h.ph.us.f
+  br label %h.us.f
+
+h.us.f:                                           ; preds = %h.us.f.ph
+  br label %body.us.f
+
+body.us.f:                                        ; preds = %h.us.f, %l.us.f
+  %i.us.f.body = phi i32 [ 0, %h.us.f ], [ %i.n.us.f, %l.us.f ]
+  br label %y.us.f
+
+y.us.f:                                           ; preds = %body.us.f
+  %ye.us.f = sext i32 %i.us.f.body to i64
+  %q.us.f = getelementptr i32, ptr %a, i64 %ye.us.f
+  store i32 2, ptr %q.us.f, align 4
+  br label %l.us.f
+
+l.us.f:                                           ; preds = %y.us.f
+  %i.n.us.f = add i32 %i.us.f.body, 1
+  %c.us.f.rot = icmp slt i32 %i.n.us.f, %n
+  br i1 %c.us.f.rot, label %body.us.f, label %e.loopexit1.loopexit
+
+h.ph:                                             ; preds = %entry
+  %c.guard = icmp slt i32 0, %n
+  br i1 %c.guard, label %h.ph2, label %e.loopexit
+
+h.ph2:                                            ; preds = %h.ph
+  br label %h
+
+h:                                                ; preds = %h.ph2
+  br label %body
+
+body:                                             ; preds = %h, %l
+  %i.body = phi i32 [ 0, %h ], [ %i.n, %l ]
+  br label %x
+
+x:                                                ; preds = %body
+  %ie = sext i32 %i.body to i64
+  %p = getelementptr i32, ptr %a, i64 %ie
+  store i32 1, ptr %p, align 4
+  br label %l
+
+l:                                                ; preds = %x
+  %i.n = add i32 %i.body, 1
+  %c.rot = icmp slt i32 %i.n, %n
+  br i1 %c.rot, label %body, label %e.loopexit.loopexit
+
+e.loopexit.loopexit:                              ; preds = %l
+  br label %e.loopexit
+
+e.loopexit:                                       ; preds = %h.ph, %e.loopexit.loopexit
+  br label %e
+
+e.loopexit1.loopexit:                             ; preds = %l.us.f
+  br label %e.loopexit1
+
+e.loopexit1:                                      ; preds = %h.ph.us.f, %e.loopexit1.loopexit
+  br label %e
+
+e:                                                ; preds = %e.loopexit1, %e.loopexit
+  ret void
+}
+
+define void @variante(ptr %a, i32 %n, i32 %k) {
+entry:
+  %c.guard = icmp slt i32 0, %n
+  br i1 %c.guard, label %h.ph, label %e
+
+h.ph:                                             ; preds = %entry
+  br label %h
+
+h:                                                ; preds = %h.ph
+  br label %body
+
+body:                                             ; preds = %h, %l
+  %i.body = phi i32 [ 0, %h ], [ %i.n, %l ]
+  %t = icmp sgt i32 %i.body, %k
+  br i1 %t, label %x, label %y
+
+x:                                                ; preds = %body
+  %ie = sext i32 %i.body to i64
+  %p = getelementptr i32, ptr %a, i64 %ie
+  store i32 1, ptr %p, align 4
+  br label %l
+
+y:                                                ; preds = %body
+  %ye = sext i32 %i.body to i64
+  %q = getelementptr i32, ptr %a, i64 %ye
+  store i32 2, ptr %q, align 4
+  br label %l
+
+l:                                                ; preds = %y, %x
+  %i.n = add i32 %i.body, 1
+  %c.rot = icmp slt i32 %i.n, %n
+  br i1 %c.rot, label %body, label %e.loopexit
+
+e.loopexit:                                       ; preds = %l
+  br label %e
+
+e:                                                ; preds = %entry, %e.loopexit
+  ret void
+}
@@ -0,0 +1,54 @@
+; versioning.ll: un load invariante con uno store che puo' essere in alias.
+; @versionato: %p e %a possono sovrapporsi. Il loop viene duplicato: se i
+; controlli a runtime escludono l'alias si esegue la copia in cui il load e'
+; nel preheader, altrimenti il loop originale.
+; @indiretto: lo store scrive a[ind[i]], un indirizzo di cui SCEV non conosce
+; l'intervallo. Non si possono costruire i controlli e il loop resta com'e'.
+define void @versionato(ptr %a, ptr %p, i32 %n) {
+entry:
+  %c0 = icmp sgt i32 %n, 0
+  br i1 %c0, label %ph, label %exit
+
+ph:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %ph ], [ %i.next, %loop ]
+  %x = load i32, ptr %p
+  %ie = sext i32 %i to i64
+  %q = getelementptr inbounds i32, ptr %a, i64 %ie
+  %y = add i32 %x, %i
+  store i32 %y, ptr %q
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+define void @indiretto(ptr %a, ptr %ind, ptr %p, i32 %n) {
+entry:
+  %c0 = icmp sgt i32 %n, 0
+  br i1 %c0, label %ph, label %exit
+
+ph:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %ph ], [ %i.next, %loop ]
+  %x = load i32, ptr %p
+  %ie = sext i32 %i to i64
+  %r = getelementptr inbounds i32, ptr %ind, i64 %ie
+  %j = load i32, ptr %r
+  %je = sext i32 %j to i64
+  %q = getelementptr inbounds i32, ptr %a, i64 %je
+  %y = add i32 %x, %i
+  store i32 %y, ptr %q
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,95 @@
+; ModuleID = '../test/versioning.ll'
+source_filename = "../test/versioning.ll"
+
+define void @versionato(ptr %a, ptr %p, i32 %n) {
+entry:
+  %c0 = icmp sgt i32 %n, 0
+  br i1 %c0, label %loop.lver.check, label %exit
+
+loop.lver.check:                                  ; preds = %entry
+  %uglygep = getelementptr i8, ptr %p, i64 4
+  %0 = add i32 %n, -1
+  %1 = zext i32 %0 to i64
+  %2 = shl nuw nsw i64 %1, 2
+  %3 = add nuw nsw i64 %2, 4
+  %uglygep1 = getelementptr i8, ptr %a, i64 %3
+  %lver.hg = icmp ult ptr %a, %uglygep
+  %lver.gh = icmp ult ptr %p, %uglygep1
+  %lver.conflict = and i1 %lver.gh, %lver.hg
+  br i1 %lver.conflict, label %loop.ph.lver.orig, label %loop.ph
+
+loop.ph.lver.orig:                                ; preds = %loop.lver.check
+  br label %loop.lver.orig
+
+loop.lver.orig:                                   ; preds = %loop.lver.orig, %loop.ph.lver.orig
+  %i.lver.orig = phi i32 [ 0, %loop.ph.lver.orig ], [ %i.next.lver.orig, %loop.lver.orig ]
+  %x.lver.orig = load i32, ptr %p, align 4
+  %ie.lver.orig = sext i32 %i.lver.orig to i64
+  %q.lver.orig = getelementptr inbounds i32, ptr %a, i64 %ie.lver.orig
+  %y.lver.orig = add i32 %x.lver.orig, %i.lver.orig
+  store i32 %y.lver.orig, ptr %q.lver.orig, align 4
+  %i.next.lver.orig = add nsw i32 %i.lver.orig, 1
+  %c.lver.orig = icmp slt i32 %i.next.lver.orig, %n
+  br i1 %c.lver.orig, label %loop.lver.orig, label %exit.loopexit.loopexit
+
+loop.ph:                                          ; preds = %loop.lver.check
+  %x = load i32, ptr %p, align 4, !alias.scope !0, !noalias !3
+  br label %loop
+
+loop:                                             ; preds = %loop, %loop.ph
+  %i = phi i32 [ 0, %loop.ph ], [ %i.next, %loop ]
+  %ie = sext i32 %i to i64
+  %q = getelementptr inbounds i32, ptr %a, i64 %ie
+  %y = add i32 %x, %i
+  store i32 %y, ptr %q, align 4, !alias.scope !3, !noalias !0
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit.loopexit.loopexit2
+
+exit.loopexit.loopexit:                           ; preds = %loop.lver.orig
+  br label %exit.loopexit
+
+exit.loopexit.loopexit2:                          ; preds = %loop
+  br label %exit.loopexit
+
+exit.loopexit:                                    ; preds = %exit.loopexit.loopexit2, %exit.loopexit.loopexit
+  br label %exit
+
+exit:                                             ; preds = %exit.loopexit, %entry
+  ret void
+}
+
+define void @indiretto(ptr %a, ptr %ind, ptr %p, i32 %n) {
+entry:
+  %c0 = icmp sgt i32 %n, 0
+  br i1 %c0, label %ph, label %exit
+
+ph:                                               ; preds = %entry
+  br label %loop
+
+loop:                                             ; preds = %loop, %ph
+  %i = phi i32 [ 0, %ph ], [ %i.next, %loop ]
+  %x = load i32, ptr %p, align 4
+  %ie = sext i32 %i to i64
+  %r = getelementptr inbounds i32, ptr %ind, i64 %ie
+  %j = load i32, ptr %r, align 4
+  %je = sext i32 %j to i64
+  %q = getelementptr inbounds i32, ptr %a, i64 %je
+  %y = add i32 %x, %i
+  store i32 %y, ptr %q, align 4
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit.loopexit
+
+exit.loopexit:                                    ; preds = %loop
+  br label %exit
+
+exit:                                             ; preds = %exit.loopexit, %entry
+  ret void
+}
+
+!0 = !{!1}
+!1 = distinct !{!1, !2, !"p"}
+!2 = distinct !{!2, !"lver"}
+!3 = !{!4}
+!4 = distinct !{!4, !2, !"a"}
@@ -32,7 +32,14 @@
 #include "llvm/IR/CFG.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
 #include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/LoopSimplify.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+#include "llvm/Support/CommandLine.h"
 #include <set>
 #include <map>
 
@@ -46,364 +53,662 @@ using namespace llvm;
 namespace {
 
 
-// New PM implementation
-struct TestPass: PassInfoMixin<TestPass> {
+// Iterazioni che si possono staccare dal loop piu' lungo per fondere due loop
+// con trip count diversi
+static cl::opt<unsigned> MaxPeel(
+    "fusion-max-peel",
+    cl::desc("Numero massimo di iterazioni copiate fuori dal loop piu' lungo"),
+    cl::init(8));
+
+// Un nodo del grafo di fusione: un loop candidato. I loop con lo stesso
+// padre sono in ordine di programma; Succ e' l'arco verso il successivo
+// quando i due sono adiacenti e control flow equivalenti. Non ci sono archi
+// di dipendenza: il pass non sposta loop, quindi si fondono solo vicini, e
+// le dipendenze si controllano al momento della fusione tra il loop gia'
+// fuso e il successivo (un arco calcolato prima sarebbe gia' vecchio).
+struct NodoFusione {
+  Loop *L;
+  bool Succ = false;
+};
 
+// Riscrive le ricorrenze sui loop del secondo nido come ricorrenze sui loop
+// corrispondenti del primo, per confrontare gli indirizzi nel loop fuso
+struct RimappaLoop : SCEVRewriteVisitor<RimappaLoop> {
+  const DenseMap<const Loop*, const Loop*> &Mappa;
 
+  RimappaLoop(ScalarEvolution &SE, const DenseMap<const Loop*, const Loop*> &Mappa)
+      : SCEVRewriteVisitor(SE), Mappa(Mappa) {}
 
-  // Main entry point, takes IR unit to run the pass on (&F) and the
-  // corresponding pass manager (to be queried if need be)
-  PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM) {
+  static const SCEV *rewrite(const SCEV *S, ScalarEvolution &SE,
+                             const DenseMap<const Loop*, const Loop*> &Mappa) {
+    RimappaLoop R(SE, Mappa);
+    return R.visit(S);
+  }
 
-    LoopInfo &LI = AM.getResult<LoopAnalysis>(F);
+  const SCEV *visitAddRecExpr(const SCEVAddRecExpr *Expr) {
+    SmallVector<const SCEV*, 2> Operandi;
+    for (const SCEV *Op : Expr->operands())
+      Operandi.push_back(visit(Op));
+    auto It = Mappa.find(Expr->getLoop());
+    const Loop *L = It == Mappa.end() ? Expr->getLoop() : It->second;
+    return SE.getAddRecExpr(Operandi, L, SCEV::FlagAnyWrap);
+  }
+};
 
-    SmallVector<Loop *, 8> Worklist;
-    for (Loop *TopLevelLoop : LI)
-    {
-      for (Loop *L : depth_first(TopLevelLoop))
-      {
-        // We only handle inner-most loops
-        if (L->isInnermost())
-          Worklist.push_back(L);
-      }
-    }
-    errs() << "Worklist ha size " << Worklist.size() << "\n";
-    
-    //Checking conditions
-
-    //Adjacent
-    SmallVector<std::pair<Loop*,Loop*>> adj;
-
-    for (size_t i = 0; i + 1 < Worklist.size(); i++) {
-      //Ultimo basic block del primo loop
-      errs() << "Cerco adiacenze tra: "
-         << Worklist[i]->getHeader()->getName() << " e "
-         << Worklist[i+1]->getHeader()->getName() << "\n";
-      Loop *l1 = Worklist[i+1];
-      BasicBlock *b1header = l1->getHeader();
-      errs() << "b1header: " << b1header->getName() << "\n";
-      BasicBlock *b1exitblock = l1->getExitBlock();
-      errs() << "b1exitblock: " << b1exitblock->getName() << "\n";
-      //Primo basic block del secondo loop
-      Loop *l2 = Worklist[i];
-      BasicBlock *b2header = l2->getHeader();
-      errs() << "b2header: " << b2header->getName() << "\n";
-      BasicBlock *b2preheader = nullptr;
-      for (BasicBlock *Pred : predecessors(b2header)) {
-        if (!l2->contains(Pred)) {
-          b2preheader = Pred;
-        }
-      }
-      errs() << "b2preheader: " << b2preheader->getName() << "\n";
-      if (!b1header || !b1exitblock || !b2header || !b2preheader) continue;
-      //Guarded
-      BasicBlock *b1headersuccessor = nullptr;
-      if (BranchInst *br = dyn_cast<BranchInst>(b1header->getTerminator()))
-      {
-        if (br->isConditional()) {
-          BasicBlock *succ0 = br->getSuccessor(0);
-          BasicBlock *succ1 = br->getSuccessor(1);
-          // Supponiamo che il corpo sia il ramo 'true' (condizione vera)
-          if (l1->contains(succ0))
-            b1headersuccessor = succ1;
-          else if (l1->contains(succ1))
-            b1headersuccessor = succ0;
-        }
-      }
-      if (b1headersuccessor == b2header)
-      {
-        adj.push_back(std::make_pair(l2, l1));
-      } //Not guarded
-      else if (b1exitblock == b2preheader)
-      {
-        adj.push_back(std::make_pair(l2, l1));
-      }
-    }
+// New PM implementation
+struct TestPass: PassInfoMixin<TestPass> {
 
-    errs() << "adj ha size " << adj.size() << "\n";
+  // Forma dei loop che il pass sa fondere (quella di un for in forma normale):
+  // preheader, header che fa il test e da cui si esce, un solo latch che
+  // torna all'header con un salto incondizionato
+  bool formaSupportata(Loop *L)
+  {
+    BasicBlock *Header = L->getHeader();
+    BasicBlock *Latch = L->getLoopLatch();
+    if (!L->getLoopPreheader() || !Latch || !L->getExitBlock() ||
+        L->getExitingBlock() != Header)
+      return false;
+    auto *BrLatch = dyn_cast<BranchInst>(Latch->getTerminator());
+    auto *BrHeader = dyn_cast<BranchInst>(Header->getTerminator());
+    return BrLatch && BrLatch->isUnconditional() && Latch != Header &&
+           BrHeader && BrHeader->isConditional();
+  }
 
-    SmallVector<Loop*, 8> Filtered;
-    for (Loop* l : Worklist){
-      bool found = false;
-      for (const auto &p : adj) {
-        if (p.first == l || p.second == l)
-          found = true;
+  // L'unico sotto-loop di L, se L e' un nido perfetto: i blocchi di L fuori
+  // dal sotto-loop formano due catene senza diramazioni (dall'header al
+  // preheader del sotto-loop e dalla sua uscita al latch) e contengono solo
+  // calcoli senza effetti e senza accessi alla memoria (induzione e test)
+  Loop *figlioPerfetto(Loop *L)
+  {
+    if (L->getSubLoops().size() != 1)
+      return nullptr;
+    Loop *Figlio = L->getSubLoops()[0];
+    if (!formaSupportata(Figlio) || (!Figlio->isInnermost() && !figlioPerfetto(Figlio)))
+      return nullptr;
+    for (BasicBlock *BB : L->blocks()) {
+      if (Figlio->contains(BB))
+        continue;
+      if (BB != L->getHeader()) {
+        auto *Br = dyn_cast<BranchInst>(BB->getTerminator());
+        if (!Br || !Br->isUnconditional())
+          return nullptr;
       }
-      if (found)
-        //Worklist.erase(Worklist.begin() + i);
-        Filtered.push_back(l);
+      for (Instruction &I : *BB)
+        if (!I.isTerminator() && (I.mayHaveSideEffects() || I.mayReadFromMemory()))
+          return nullptr;
     }
-    Worklist = Filtered;
-    errs() << "Worklist (aggiornato dopo adiacenze) ha size " << Worklist.size() << "\n";
+    return Figlio;
+  }
 
-    //Control Flow Equivalent
-    DominatorTree &DT = AM.getResult<DominatorTreeAnalysis>(F); 
-    PostDominatorTree &PDT = AM.getResult<PostDominatorTreeAnalysis>(F);
+  // Adiacenti: l'uscita del primo e' il preheader (vuoto) del secondo
+  bool adiacenti(Loop *L0, Loop *L1)
+  {
+    BasicBlock *Exit0 = L0->getExitBlock();
+    if (!Exit0 || Exit0 != L1->getLoopPreheader())
+      return false;
+    return Exit0->size() == 1;
+  }
 
-    //Vettore che indica se un loop domina ed è post-dominato dal loop successivo
-    SmallVector<bool> CFE;
-    SmallVector<std::pair<Loop*,Loop*>>  Updated; // coppie di loop con control flow equivalente
-
-    for (std::pair p : adj)
-    {
-      Loop *L0 = p.second;
-      Loop *L1 = p.first;
-      BasicBlock *H0 = L0->getHeader();
-      BasicBlock *H1 = L1->getHeader();
-      bool equiv = false;
-
-      if (DT.dominates(H0, H1) && PDT.dominates(H1, H0)) { // dominanza e post dominanza
-        equiv = true;
-        Updated.push_back(std::make_pair(L0, L1));
-      }
-      CFE.push_back(equiv);
+  // Control flow equivalenti: se esegue uno esegue anche l'altro
+  bool controlFlowEquivalenti(Loop *L0, Loop *L1, DominatorTree &DT,
+                              PostDominatorTree &PDT)
+  {
+    BasicBlock *H0 = L0->getHeader();
+    BasicBlock *H1 = L1->getHeader();
+    return DT.dominates(H0, H1) && PDT.dominates(H1, H0);
+  }
+
+  // Differenza tra i numeri di iterazioni (BTC1 - BTC0), se e' una costante:
+  // 0 quando i backedge-taken count dei due loop sono lo stesso SCEV (es.
+  // smax(n, 0) per due for fino a n), oppure SCEV uguali secondo le
+  // condizioni che dominano il secondo loop
+  bool differenzaTripCount(Loop *L0, Loop *L1, ScalarEvolution &SE, DominatorTree &DT,
+                           int64_t &Diff)
+  {
+    Diff = 0;
+    const SCEV *BTC0 = SE.getBackedgeTakenCount(L0);
+    const SCEV *BTC1 = SE.getBackedgeTakenCount(L1);
+    errs() << "Backedge-taken count: " << *BTC0 << " e " << *BTC1 << "\n";
+    if (isa<SCEVCouldNotCompute>(BTC0) || isa<SCEVCouldNotCompute>(BTC1))
+      return false;
+    if (BTC0 == BTC1)
+      return true;
+    // Contatori di larghezza diversa (es. i32 e i64): sono valori senza segno
+    Type *Ty = SE.getWiderType(BTC0->getType(), BTC1->getType());
+    BTC0 = SE.getNoopOrZeroExtend(BTC0, Ty);
+    BTC1 = SE.getNoopOrZeroExtend(BTC1, Ty);
+    const SCEV *Tot0 = BTC0, *Tot1 = BTC1;
+    if (BTC0 == BTC1 ||
+        SE.isKnownPredicateAt(ICmpInst::ICMP_EQ, BTC0, BTC1,
+                              L1->getLoopPreheader()->getTerminator()))
+      return true;
+    // Condizioni di uguaglianza che dominano il secondo loop (es. un
+    // if (n == m) intorno ai due loop): sostituisco un lato con l'altro.
+    // Le condizioni dentro il primo loop non valgono per tutto il loop.
+    ValueToSCEVMapTy Uguali;
+    BasicBlock *BB = L1->getLoopPreheader();
+    for (DomTreeNode *N = DT.getNode(BB)->getIDom(); N; N = N->getIDom()) {
+      if (L0->contains(N->getBlock()))
+        continue;
+      auto *Br = dyn_cast<BranchInst>(N->getBlock()->getTerminator());
+      ICmpInst *Cmp = Br && Br->isConditional() ? dyn_cast<ICmpInst>(Br->getCondition()) : nullptr;
+      if (!Cmp || !Cmp->isEquality())
+        continue;
+      BasicBlock *SeUguali = Br->getSuccessor(Cmp->getPredicate() == ICmpInst::ICMP_EQ ? 0 : 1);
+      if (DT.dominates(BasicBlockEdge(N->getBlock(), SeUguali), BB))
+        Uguali[Cmp->getOperand(0)] = SE.getSCEV(Cmp->getOperand(1));
     }
+    BTC0 = SCEVParameterRewriter::rewrite(BTC0, SE, Uguali);
+    BTC1 = SCEVParameterRewriter::rewrite(BTC1, SE, Uguali);
+    if (BTC0 == BTC1)
+      return true;
+
+    // Differenza costante (es. 100 e 98 iterazioni): il loop piu' lungo fa
+    // davvero almeno Diff iterazioni in piu' (niente overflow del contatore)
+    auto *C = dyn_cast<SCEVConstant>(SE.getMinusSCEV(BTC1, BTC0));
+    if (!C || C->getAPInt().getSignificantBits() > 64)
+      return false;
+    Diff = C->getAPInt().getSExtValue();
+    const SCEV *Lungo = Diff > 0 ? Tot1 : Tot0;
+    const SCEV *Passi = SE.getConstant(Lungo->getType(), Diff > 0 ? Diff : -Diff);
+    return SE.isKnownPredicate(ICmpInst::ICMP_UGE, Lungo, Passi);
+  }
 
-    errs() << "Updated (dopo CFE) ha size " << Updated.size() << "\n";
+  // Passi costanti (in byte) di un indirizzo sui livelli di un nido, dal
+  // piu' interno: l'indirizzo deve essere una ricorrenza affine su ognuno
+  bool passiIndirizzo(const SCEV *S, ArrayRef<Loop*> Livelli, ScalarEvolution &SE,
+                      SmallVectorImpl<int64_t> &Passi)
+  {
+    for (Loop *L : reverse(Livelli)) {
+      auto *AR = dyn_cast<SCEVAddRecExpr>(S);
+      if (!AR || AR->getLoop() != L || !AR->isAffine())
+        return false;
+      auto *Passo = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+      if (!Passo || Passo->getAPInt().getSignificantBits() > 64)
+        return false;
+      Passi.push_back(Passo->getAPInt().getSExtValue());
+      S = AR->getStart();
+    }
+    return true;
+  }
 
-    //Loop Trip Count
-    ScalarEvolution &SE = AM.getResult<ScalarEvolutionAnalysis>(F);
-    std::map<Loop*, unsigned> TripCount; // uso mappa per facilitare la dependence analysis
-    
-    for (std::pair p : Updated)
-    {
-      Loop *L0 = p.second;
-      Loop *L1 = p.first;
-      unsigned TC0 = SE.getSmallConstantTripCount(L0);
-      unsigned TC1 = SE.getSmallConstantTripCount(L1);
-      if (TC0 > 0) TripCount[L0] = TC0;
-      if (TC1 > 0) TripCount[L1] = TC1;
+  // Una dipendenza tra I0 (nel primo nido) e I1 (nel secondo) resta in
+  // avanti dopo la fusione? I vettori di DependenceInfo coprono solo i loop
+  // comuni, cioe' quelli che contengono i due nidi: se a uno di questi
+  // livelli la direzione esclude "=", la dipendenza e' portata dal loop
+  // esterno e la fusione non la tocca. Per i livelli fusi la distanza si
+  // calcola con SCEV, riscrivendo l'indirizzo di I1 sui loop del primo nido:
+  // - distanza 0 su tutti i livelli: stesse iterazioni, nel loop fuso I0
+  //   viene prima di I1 (serve che indirizzi diversi non si sovrappongano);
+  // - un solo livello: la distanza d (I1 all'iterazione k tocca quello che
+  //   I0 ha toccato all'iterazione k - d) deve essere >= 0, con d < 0 la
+  //   dipendenza diventerebbe all'indietro.
+  //
+  // NelHeader: uno dei due accessi sta nell'header del loop piu' interno
+  bool distanzaValida(Instruction &I0, Instruction &I1, Dependence &Dep,
+                      ArrayRef<Loop*> Livelli, const DenseMap<const Loop*, const Loop*> &Mappa,
+                      bool NelHeader, ScalarEvolution &SE)
+  {
+    for (unsigned l = 1; l <= Dep.getLevels(); l++)
+      if (!(Dep.getDirection(l) & Dependence::DVEntry::EQ))
+        return true;
+
+    Value *P0 = getLoadStorePointerOperand(&I0);
+    Value *P1 = getLoadStorePointerOperand(&I1);
+    if (!P0 || !P1)
+      return false;
+    const DataLayout &DL = I0.getModule()->getDataLayout();
+    TypeSize Dim = DL.getTypeStoreSize(getLoadStoreType(&I0));
+    if (Dim.isScalable() || Dim != DL.getTypeStoreSize(getLoadStoreType(&I1)))
+      return false;
+
+    const SCEV *S0 = SE.getSCEV(P0);
+    const SCEV *S1 = RimappaLoop::rewrite(SE.getSCEV(P1), SE, Mappa);
+    auto *Delta = dyn_cast<SCEVConstant>(SE.getMinusSCEV(S0, S1));
+    SmallVector<int64_t, 4> Passi;
+    if (!Delta || Delta->getAPInt().getSignificantBits() > 64 ||
+        !passiIndirizzo(S0, Livelli, SE, Passi))
+      return false;
+
+    // Iterazioni diverse toccano byte diversi: ogni passo copre i byte
+    // toccati da tutte le iterazioni dei livelli sotto (nella forma
+    // supportata il corpo esegue un'iterazione in meno dell'header)
+    uint64_t Coperti = Dim.getFixedValue();
+    for (unsigned l = 0; l < Passi.size(); l++) {
+      if ((uint64_t)std::abs(Passi[l]) < Coperti)
+        return false;
+      if (l + 1 == Passi.size())
+        break;
+      // Valori dell'induzione visti dagli accessi, meno uno
+      unsigned Iter = SE.getSmallConstantMaxTripCount(Livelli[Livelli.size() - 1 - l]);
+      unsigned Meno = l > 0 || !NelHeader ? 2 : 1;
+      if (Iter < Meno)
+        return false;
+      Coperti += (uint64_t)std::abs(Passi[l]) * (Iter - Meno);
     }
 
-    errs() << "Ho fatto TripCount\n";
+    int64_t D = Delta->getAPInt().getSExtValue();
+    if (D == 0)
+      return true;
+    if (Passi.size() > 1 || D % Passi[0] != 0)
+      return false;
+    errs() << "   Distanza " << D / Passi[0] << " tra " << I0 << " e " << I1 << "\n";
+    return D / Passi[0] >= 0;
+  }
 
-    //Dependence Analysis
-    SmallVector<std::pair<Loop*, Loop*>, 8> Fusable;
-    DependenceInfo &DI = AM.getResult<DependenceAnalysis>(F);
-    for (std::pair p : Updated) {
-      Loop *l1 = p.second;
-      Loop *l2 = p.first;
-      if (TripCount.count(l1) == 0 || TripCount.count(l2) == 0) continue; // è necessario o posso toglierlo?
-      bool hasDependence = false;
-      for (auto *bb1 : l1->blocks()){
-        for (auto &i1 : *bb1){
-          for (auto *bb2 : l2->blocks()){
-            for (auto &i2 : *bb2){
-              if (auto dep = DI.depends(&i1, &i2, true))
-                hasDependence = true;
+  // Dipendenze tra gli accessi alla memoria dei due nidi che impediscono la
+  // fusione (vedi distanzaValida)
+  bool haDipendenze(Loop *L0, Loop *L1, ScalarEvolution &SE, DependenceInfo &DI)
+  {
+    // Livelli che verranno fusi, dall'esterno, e per ognuno il loop del
+    // secondo nido associato a quello del primo
+    SmallVector<Loop*, 4> Livelli;
+    DenseMap<const Loop*, const Loop*> Mappa;
+    Loop *A = L0, *B = L1;
+    for (;; A = A->getSubLoops()[0], B = B->getSubLoops()[0]) {
+      Livelli.push_back(A);
+      Mappa[B] = A;
+      if (A->isInnermost())
+        break;
+    }
+
+    for (auto *bb1 : L0->blocks())
+      for (auto &i1 : *bb1) {
+        if (!i1.mayReadOrWriteMemory())
+          continue;
+        for (auto *bb2 : L1->blocks())
+          for (auto &i2 : *bb2) {
+            if (!i2.mayReadOrWriteMemory() ||
+                (!i1.mayWriteToMemory() && !i2.mayWriteToMemory()))
+              continue;
+            auto dep = DI.depends(&i1, &i2, true);
+            bool NelHeader = bb1 == A->getHeader() || bb2 == B->getHeader();
+            if (dep && !distanzaValida(i1, i2, *dep, Livelli, Mappa, NelHeader, SE)) {
+              errs() << "   Dipendenza che impedisce la fusione: " << i1 << " -> " << i2 << "\n";
+              return true;
             }
-            if (hasDependence) break;
           }
-          if (hasDependence) break;
-        }
-        if (hasDependence) break;
       }
-      if (!hasDependence) {
-        // Fusable potrebbe contenere dei duplicati... è un problema?
-        Fusable.push_back({l1, l2});
-      }
-    }
+    return false;
+  }
 
-    errs() << "Fusable ha size " << Fusable.size() << "\n";
-    
-    //Trasformazione del codice
-    for (auto &p : Fusable) {
-      Loop *l1 = p.second;
-      Loop *l2 = p.first;
-      errs() << "   " << l1->getName() << ", " << l2->getName() << "\n";
-
-      // Prendo latch e header
-      SmallVector<BasicBlock *, 2> latches1, latches2;
-      l1->getLoopLatches(latches1);
-      l2->getLoopLatches(latches2);
-      if (latches1.size() != 1 || latches2.size() != 1) {
-        errs() << "---Errore size latches\n";
+  // Condizioni sui valori scalari: il secondo loop non usa valori calcolati
+  // dal primo (sarebbero i valori finali), e le istruzioni dell'header del
+  // secondo, che nel loop fuso non vengono eseguite all'ultimo test, non
+  // hanno effetti e non sono usate dopo il loop
+  bool valoriCompatibili(Loop *L0, Loop *L1)
+  {
+    for (BasicBlock *BB : L1->blocks())
+      for (Instruction &I : *BB)
+        for (Value *Op : I.operands())
+          if (auto *OpI = dyn_cast<Instruction>(Op))
+            if (L0->contains(OpI))
+              return false;
+    for (Instruction &I : *L1->getHeader()) {
+      if (isa<PHINode>(I) || I.isTerminator())
         continue;
-      }
-      BasicBlock *latch1 = latches1[0];
-      BasicBlock *header1 = l1->getHeader();
-      BasicBlock *header2 = l2->getHeader();
-      //BasicBlock *preheader2 = l2->getLoopPreheader();
-      if (!latch1) {
-        errs() << "---Errore latch1\n";
-        continue;
-      } else if (!header2) {
-        errs() << "---Errore header2\n";
-        continue;
-      } else if (!header1) {
-        errs() << "---Errore header1\n";
+      if (I.mayHaveSideEffects())
+        return false;
+      for (User *U : I.users())
+        if (!L1->contains(cast<Instruction>(U)))
+          return false;
+    }
+    return true;
+  }
+
+  // Per due nidi perfetti le condizioni valgono livello per livello. Tra un
+  // sotto-loop e l'altro restano i blocchi di induzione e test dei loop
+  // esterni: fra l'uscita del primo sotto-loop e il preheader del secondo
+  // non ci devono essere usi dei valori del primo.
+  //
+  // Se Peel non e' nullo (primo livello di due loop interni) i trip count
+  // possono differire di poche iterazioni: in Peel quelle del secondo loop
+  // in piu' (negativo se e' piu' lungo il primo)
+  bool livelliCompatibili(Loop *L0, Loop *L1, ScalarEvolution &SE, DominatorTree &DT,
+                          int64_t *Peel)
+  {
+    int64_t Diff;
+    if (!differenzaTripCount(L0, L1, SE, DT, Diff)) {
+      errs() << "   Trip count diversi\n";
+      return false;
+    }
+    if (Diff != 0) {
+      errs() << "   Trip count diversi di " << Diff << " iterazioni\n";
+      if (!Peel || !L0->isInnermost() || !L1->isInnermost() ||
+          (uint64_t)std::abs(Diff) > MaxPeel)
+        return false;
+      *Peel = Diff;
+    }
+    if (!valoriCompatibili(L0, L1)) {
+      errs() << "   Il secondo loop usa valori del primo\n";
+      return false;
+    }
+    if (L0->isInnermost() && L1->isInnermost())
+      return true;
+    Loop *C0 = figlioPerfetto(L0), *C1 = figlioPerfetto(L1);
+    if (!C0 || !C1) {
+      errs() << "   Nidi di profondita' diversa\n";
+      return false;
+    }
+    for (BasicBlock *BB : L0->blocks()) {
+      if (C0->contains(BB))
         continue;
-      /*} else if (!preheader2) {
-        errs() << "---Errore preheader2\n";
-        continue;*/
-      }
+      for (Instruction &I : *BB)
+        for (Value *Op : I.operands())
+          if (auto *OpI = dyn_cast<Instruction>(Op))
+            if (C0->contains(OpI)) {
+              errs() << "   Il loop esterno usa valori del sotto-loop\n";
+              return false;
+            }
+    }
+    return livelliCompatibili(C0, C1, SE, DT, nullptr);
+  }
 
-      errs() << "   Controlli finiti\n";
+  // Peel: vedi livelliCompatibili. Le dipendenze si controllano sui loop
+  // allineati, prima del peeling: anticipare le iterazioni del primo loop o
+  // posticipare quelle del secondo non crea dipendenze all'indietro
+  bool fondibili(Loop *L0, Loop *L1, ScalarEvolution &SE, DominatorTree &DT,
+                 DependenceInfo &DI, int64_t &Peel)
+  {
+    Peel = 0;
+    if (!livelliCompatibili(L0, L1, SE, DT, &Peel))
+      return false;
+    if (haDipendenze(L0, L1, SE, DI)) {
+      errs() << "   Dipendenze tra i due loop\n";
+      return false;
+    }
+    return true;
+  }
 
-      // Recupero IV1 e IV2
-      PHINode *IV1 = dyn_cast<PHINode>(header1->begin());
-      PHINode *IV2 = dyn_cast<PHINode>(header2->begin());
-      if (!IV1 || !IV2) continue;
+  // Copia di un'iterazione di un loop interno fuori dal loop, davanti a
+  // Prima: header (senza test, l'iterazione viene eseguita di sicuro),
+  // corpo e latch. Stato contiene i valori dei PHI dell'header all'inizio
+  // dell'iterazione e alla fine quelli per l'iterazione successiva. Il
+  // latch copiato salta ancora alla copia dell'header: lo aggancia il
+  // chiamante.
+  BasicBlock *copiaIterazione(Loop *L, DenseMap<PHINode*, Value*> &Stato,
+                              BasicBlock *Prima, BasicBlock *&LatchCopia,
+                              SmallPtrSetImpl<BasicBlock*> &Copie, LoopInfo &LI)
+  {
+    BasicBlock *Header = L->getHeader();
+    Function *F = Header->getParent();
+    ValueToValueMapTy VMap;
+    SmallVector<BasicBlock*, 8> Nuovi;
+    for (BasicBlock *BB : L->blocks()) {
+      BasicBlock *C = CloneBasicBlock(BB, VMap, ".peel", F);
+      C->moveBefore(Prima);
+      VMap[BB] = C;
+      Nuovi.push_back(C);
+      Copie.insert(C);
+      if (Loop *Padre = L->getParentLoop())
+        Padre->addBasicBlockToLoop(C, LI);
+    }
+    for (PHINode &PN : Header->phis()) {
+      cast<PHINode>(VMap[&PN])->eraseFromParent();
+      VMap[&PN] = Stato[&PN];
+    }
+    remapInstructionsInBlocks(Nuovi, VMap);
+
+    auto *BrOrig = cast<BranchInst>(Header->getTerminator());
+    unsigned Dentro = L->contains(BrOrig->getSuccessor(0)) ? 0 : 1;
+    BasicBlock *HeaderCopia = cast<BasicBlock>(VMap[Header]);
+    auto *Br = cast<BranchInst>(HeaderCopia->getTerminator());
+    BranchInst::Create(Br->getSuccessor(Dentro), Br);
+    Br->eraseFromParent();
+
+    BasicBlock *Latch = L->getLoopLatch();
+    LatchCopia = cast<BasicBlock>(VMap[Latch]);
+    for (PHINode &PN : Header->phis()) {
+      Value *V = PN.getIncomingValueForBlock(Latch);
+      Stato[&PN] = VMap.count(V) ? static_cast<Value*>(VMap[V]) : V;
+    }
+    return HeaderCopia;
+  }
+
+  // Peeling delle prime N iterazioni di L, davanti al loop
+  void peelPrima(Loop *L, unsigned N, LoopInfo &LI, ScalarEvolution &SE)
+  {
+    BasicBlock *Preheader = L->getLoopPreheader();
+    BasicBlock *Header = L->getHeader();
+    errs() << "Peeling di " << N << " iterazioni all'inizio di " << Header->getName() << "\n";
+    SE.forgetLoop(L);
+    DenseMap<PHINode*, Value*> Stato;
+    for (PHINode &PN : Header->phis())
+      Stato[&PN] = PN.getIncomingValueForBlock(Preheader);
+    SmallPtrSet<BasicBlock*, 16> Copie;
+    BasicBlock *Ultimo = Preheader;
+    for (unsigned k = 0; k < N; k++) {
+      BasicBlock *LatchCopia;
+      BasicBlock *Copia = copiaIterazione(L, Stato, Header, LatchCopia, Copie, LI);
+      Ultimo->getTerminator()->replaceSuccessorWith(Header, Copia);
+      LatchCopia->getTerminator()->replaceSuccessorWith(Copia, Header);
+      Ultimo = LatchCopia;
+    }
+    // Il loop parte dallo stato dopo le iterazioni copiate
+    for (PHINode &PN : Header->phis()) {
+      int k = PN.getBasicBlockIndex(Preheader);
+      PN.setIncomingValue(k, Stato[&PN]);
+      PN.setIncomingBlock(k, Ultimo);
+    }
+  }
 
-      errs() << "   PHI1: " << *IV1 << "\n";
-      errs() << "   PHI2: " << *IV2 << "\n";
+  // Peeling delle ultime N iterazioni di L, dopo il loop: le copie stanno
+  // sull'uscita. Da sole farebbero N iterazioni in piu': servono dopo la
+  // fusione, quando a uscire e' il test del loop piu' corto. Gli usi dopo
+  // il loop dei PHI dell'header vedono lo stato dopo l'ultima copia.
+  void peelDopo(Loop *L, unsigned N, LoopInfo &LI, ScalarEvolution &SE)
+  {
+    BasicBlock *Header = L->getHeader();
+    BasicBlock *Exit = L->getExitBlock();
+    errs() << "Peeling di " << N << " iterazioni alla fine di " << Header->getName() << "\n";
+    SE.forgetLoop(L);
+    DenseMap<PHINode*, Value*> Stato;
+    for (PHINode &PN : Header->phis())
+      Stato[&PN] = &PN;
+    SmallPtrSet<BasicBlock*, 16> Copie;
+    BasicBlock *Ultimo = Header;
+    for (unsigned k = 0; k < N; k++) {
+      BasicBlock *LatchCopia;
+      BasicBlock *Copia = copiaIterazione(L, Stato, Exit, LatchCopia, Copie, LI);
+      Ultimo->getTerminator()->replaceSuccessorWith(Exit, Copia);
+      LatchCopia->getTerminator()->replaceSuccessorWith(Copia, Exit);
+      Ultimo = LatchCopia;
+    }
+    for (PHINode &PN : Exit->phis())
+      for (unsigned k = 0; k < PN.getNumIncomingValues(); k++)
+        if (PN.getIncomingBlock(k) == Header)
+          PN.setIncomingBlock(k, Ultimo);
+    for (PHINode &PN : Header->phis())
+      PN.replaceUsesWithIf(Stato[&PN], [&](Use &U) {
+        auto *I = cast<Instruction>(U.getUser());
+        return !L->contains(I) && !Copie.count(I->getParent());
+      });
+  }
 
-      /* Modificare gli usi della induction variable nel body del 
-        loop 2 con quelli della induction variable del loop 1*/
-      for (BasicBlock *BB : l2->blocks()) {
-        if (BB == header2) continue;
-        for (Instruction &I : *BB) {
-          for (unsigned i = 0; i < I.getNumOperands(); ++i) {
-            if (I.getOperand(i) == IV2) {
-              I.setOperand(i, IV1);
-            }
-          }
-        }
-      }
+  // Fusione di L1 in L0. Il corpo di L1 (header compreso, senza il test)
+  // viene eseguito dopo quello di L0:
+  //
+  //   H0 -test-> corpo0 -> Latch0 -> H1 -> corpo1 -> Latch1 -> H0
+  //
+  // e dall'header di L0 si esce direttamente all'uscita di L1. I PHI di H1
+  // passano in H0; il preheader di L1 (l'uscita di L0) sparisce.
+  // LoopInfo viene aggiornato spostando i blocchi di L1 in L0, dominator e
+  // post-dominator tree vengono ricalcolati.
+  void fondi(Loop *L0, Loop *L1, DominatorTree &DT, PostDominatorTree &PDT,
+             LoopInfo &LI, ScalarEvolution &SE)
+  {
+    BasicBlock *Preheader0 = L0->getLoopPreheader();
+    BasicBlock *H0 = L0->getHeader(), *H1 = L1->getHeader();
+    BasicBlock *Latch0 = L0->getLoopLatch(), *Latch1 = L1->getLoopLatch();
+    BasicBlock *Preheader1 = L1->getLoopPreheader();
+    BasicBlock *Exit1 = L1->getExitBlock();
+    errs() << "Fondo " << H0->getName() << " e " << H1->getName() << "\n";
+    SE.forgetLoop(L0);
+    SE.forgetLoop(L1);
+
+    // Latch0 salta a H1, Latch1 torna a H0
+    Latch0->getTerminator()->replaceSuccessorWith(H0, H1);
+    Latch1->getTerminator()->replaceSuccessorWith(H1, H0);
+
+    // H1 salta sempre nel corpo
+    auto *BrH1 = cast<BranchInst>(H1->getTerminator());
+    BasicBlock *Corpo1 = L1->contains(BrH1->getSuccessor(0)) ? BrH1->getSuccessor(0)
+                                                              : BrH1->getSuccessor(1);
+    BranchInst::Create(Corpo1, BrH1);
+    BrH1->eraseFromParent();
+
+    // Da H0 si esce all'uscita di L1
+    H0->getTerminator()->replaceSuccessorWith(Preheader1, Exit1);
+    for (PHINode &PN : Exit1->phis())
+      for (unsigned k = 0; k < PN.getNumIncomingValues(); k++)
+        if (PN.getIncomingBlock(k) == H1)
+          PN.setIncomingBlock(k, H0);
+
+    // PHI: il back-edge ora arriva da Latch1; quelli di H1 passano in H0
+    for (PHINode &PN : H0->phis())
+      for (unsigned k = 0; k < PN.getNumIncomingValues(); k++)
+        if (PN.getIncomingBlock(k) == Latch0)
+          PN.setIncomingBlock(k, Latch1);
+    Instruction *PrimaNonPHI = H0->getFirstNonPHI();
+    for (PHINode &PN : make_early_inc_range(H1->phis())) {
+      for (unsigned k = 0; k < PN.getNumIncomingValues(); k++)
+        if (PN.getIncomingBlock(k) == Preheader1)
+          PN.setIncomingBlock(k, Preheader0);
+      PN.moveBefore(PrimaNonPHI);
+    }
 
-      errs() << "   Modificato usi IV2\n";
-
-      /* Modificare il CFG perché il body del loop 2 sia 
-        agganciato a seguito del body del loop 1 nel loop 1*/
-
-      BasicBlock *body2 = nullptr;
-      BasicBlock *body1 = nullptr;
-      if (BranchInst *br = dyn_cast<BranchInst>(header1->getTerminator())) { // ricavo body1
-        if (br->isConditional()) {
-          BasicBlock *succ0 = br->getSuccessor(0);
-          BasicBlock *succ1 = br->getSuccessor(1);
-          // Supponiamo che il corpo sia il ramo 'true' (condizione vera)
-          if (l1->contains(succ0))
-            body1 = succ0;
-          else if (l1->contains(succ1))
-            body1 = succ1;
-        }
-      }
-      if (BranchInst *br = dyn_cast<BranchInst>(header2->getTerminator())) { // ricavo body2
-        if (br->isConditional()) {
-          BasicBlock *succ0 = br->getSuccessor(0);
-          BasicBlock *succ1 = br->getSuccessor(1);
-          if (l2->contains(succ0))
-            body2 = succ0;
-          else if (l2->contains(succ1))
-            body2 = succ1;
-        }
-      }
+    // Il preheader di L1 non e' piu' raggiungibile
+    LI.removeBlock(Preheader1);
+    Preheader1->eraseFromParent();
+
+    // I blocchi (e i sotto-loop) di L1 passano a L0
+    SmallVector<BasicBlock*, 8> Blocchi(L1->blocks());
+    for (BasicBlock *BB : Blocchi) {
+      L0->addBlockEntry(BB);
+      L1->removeBlockFromLoop(BB);
+      if (LI.getLoopFor(BB) == L1)
+        LI.changeLoopFor(BB, L0);
+    }
+    while (!L1->isInnermost()) {
+      Loop *Figlio = *L1->begin();
+      L1->removeChildLoop(L1->begin());
+      L0->addChildLoop(Figlio);
+    }
+    LI.erase(L1);
 
-            
-      Instruction *term1 = body1->getTerminator();
-      Instruction *term2 = body2->getTerminator();
+    DT.recalculate(*H0->getParent());
+    PDT.recalculate(*H0->getParent());
+  }
 
-      errs() << "body1: " << body1->getName() << ". body2: " << body2->getName() << "\n";
-      
+  // Dopo la fusione dei loop esterni i due sotto-loop sono fratelli, separati
+  // dai blocchi di induzione e test dei loop esterni (uscita di C0, latch
+  // del primo, header del secondo, preheader di C1). La catena viene fusa
+  // in un solo blocco e le sue istruzioni, senza effetti, salgono nel
+  // preheader di C0: il blocco vuoto che resta e' l'uscita di C0 e il
+  // preheader di C1.
+  void rendiAdiacenti(Loop *C0, Loop *C1, DominatorTree &DT, PostDominatorTree &PDT,
+                      LoopInfo &LI)
+  {
+    BasicBlock *Uscita = C0->getExitBlock();
+    while (Uscita->getSingleSuccessor() != C1->getHeader())
+      MergeBlockIntoPredecessor(Uscita->getSingleSuccessor(), nullptr, &LI);
+    Instruction *Punto = C0->getLoopPreheader()->getTerminator();
+    for (Instruction &I : make_early_inc_range(*Uscita))
+      if (!I.isTerminator())
+        I.moveBefore(Punto);
+    DT.recalculate(*Uscita->getParent());
+    PDT.recalculate(*Uscita->getParent());
+  }
 
-      errs() << "Blocchi in l2:\n";
-      for (BasicBlock *BB : l2->blocks()) {
-          errs() << "  " << BB->getName() << "\n";
-          Instruction *term = BB->getTerminator();
-          if (term)
-              errs() << "    terminator: " << *term << "\n";
-      }
+  // Fusione livello per livello: prima i loop esterni, poi i loro sotto-loop,
+  // resi adiacenti
+  void fondiNido(Loop *L0, Loop *L1, DominatorTree &DT, PostDominatorTree &PDT,
+                 LoopInfo &LI, ScalarEvolution &SE)
+  {
+    Loop *C0 = L0->isInnermost() ? nullptr : L0->getSubLoops()[0];
+    Loop *C1 = L1->isInnermost() ? nullptr : L1->getSubLoops()[0];
+    fondi(L0, L1, DT, PDT, LI, SE);
+    if (!C0)
+      return;
+    rendiAdiacenti(C0, C1, DT, PDT, LI);
+    fondiNido(C0, C1, DT, PDT, LI, SE);
+  }
 
+  // Main entry point, takes IR unit to run the pass on (&F) and the
+  // corresponding pass manager (to be queried if need be)
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM) {
 
-      // header2 salta a latch2
-      Instruction *termHeader2 = header2->getTerminator();
-      Instruction *Br = nullptr;
-      BasicBlock *latch2 = nullptr;
-      for (BasicBlock *BB : l2->blocks()) {
-        if (BB != header2 && BB != body2) latch2 = BB;
-      }
-      if (termHeader2) termHeader2->eraseFromParent();
-      if (latch2){
-        Br = BranchInst::Create(latch2, header2);
-        errs() << "   header2 salta a latch2 " << *Br << "\n";
-      } else {
-        errs() << "---ERRORE: latch2 non trovato!\n";
-      }
-      
+    LoopInfo &LI = AM.getResult<LoopAnalysis>(F);
+    DominatorTree &DT = AM.getResult<DominatorTreeAnalysis>(F);
+    ScalarEvolution &SE = AM.getResult<ScalarEvolutionAnalysis>(F);
 
-      // body1 salta a body2
-      if (term1){
-        errs() << "   Prima: body1->term = " << *term1 << "\n";
-        term1->eraseFromParent(); 
-      }
-      IRBuilder<> builder(body1);
-      Br = builder.CreateBr(body2);
-      errs() << "   body1 salta a body2: " << *Br << "\n";
-
-      // body2 salta a latch1
-      term2->eraseFromParent();
-      Br = BranchInst::Create(latch1, body2);
-      errs() << "   body2 salta a latch1 " << *Br << "\n";
-
-      // header1 salta a body1 o end
-      //Instruction *termHeader1 = header1->getTerminator();
-      //if (termHeader1) termHeader1->eraseFromParent();
-
-      BasicBlock *endBlock = nullptr; // recupero blocco end (che prima era dopo header2 con condizione falsa)
-      for (BasicBlock &BB : *header1->getParent()) {
-        Instruction *term = BB.getTerminator();
-        if (!term) continue; // salta blocchi malformati
-        if (isa<ReturnInst>(term)) {
-          endBlock = &BB;
-          errs() << "   Blocco end: " << endBlock->getName() << "\n";
-          break;
-        }
-      }
-      if (!endBlock) errs() << "   Non ho trovato end!!! ERRORE\n";
-
-      IRBuilder<> builder2(header1);
-      builder2.SetInsertPoint(header1);
-      Instruction *term = header1->getTerminator();
-      if (term) {
-        if (auto *br = dyn_cast<BranchInst>(term)) {
-          Value *cond = nullptr;
-          BasicBlock *trueDest = nullptr;
-          BasicBlock *falseDest = nullptr;
-
-          if (br->isConditional()) {
-            cond = br->getCondition();
-            trueDest = br->getSuccessor(0);
-            falseDest = br->getSuccessor(1);
-          } else {
-            trueDest = br->getSuccessor(0);
-          }
+    // Forma normale: preheader e uscite dedicate, cosi' due loop consecutivi
+    // sono collegati dall'uscita del primo, che e' il preheader del secondo
+    bool Changed = false;
+    for (Loop *L : LI)
+      Changed |= simplifyLoop(L, &DT, &LI, &SE, nullptr, nullptr, /*PreserveLCSSA=*/false);
+    PostDominatorTree &PDT = AM.getResult<PostDominatorTreeAnalysis>(F);
+    PDT.recalculate(F);
+    DependenceInfo &DI = AM.getResult<DependenceAnalysis>(F);
 
-          br->eraseFromParent();
+    // Candidati: i loop piu' interni e i nidi perfetti, raggruppati per
+    // padre in ordine di programma (getLoopsInPreorder visita i fratelli in
+    // avanti)
+    MapVector<Loop*, SmallVector<NodoFusione, 8>> Gruppi;
+    for (Loop *L : LI.getLoopsInPreorder())
+      if (formaSupportata(L) && (L->isInnermost() || figlioPerfetto(L))) {
+        Gruppi[L->getParentLoop()].push_back({L});
+        // PHI con un solo predecessore (es. LCSSA) al posto del loro valore
+        Changed |= FoldSingleEntryPHINodes(L->getExitBlock());
+      }
 
-          if (cond && trueDest && endBlock) {
-            Instruction *newBr = BranchInst::Create(trueDest, endBlock, cond, header1);
-            errs() << "   header1 salta a body1 / end (condizione originale mantenuta): " << *newBr << "\n";
-          } else if (trueDest) {
-            Instruction *newBr = BranchInst::Create(trueDest, header1);
-            errs() << "   header1 salta a " << trueDest->getName() << " (branch non condizionale): " << *newBr << "\n";
-          } else {
-            errs() << "---Errore: impossibile creare terminator valido per header1\n";
-          }
-        }
+    // Grafo di fusione: archi tra loop consecutivi adiacenti e control flow
+    // equivalenti
+    unsigned Archi = 0;
+    for (auto &G : Gruppi)
+      for (size_t i = 0; i + 1 < G.second.size(); i++) {
+        Loop *L0 = G.second[i].L, *L1 = G.second[i + 1].L;
+        errs() << "Cerco adiacenze tra: " << L0->getHeader()->getName() << " e "
+               << L1->getHeader()->getName() << "\n";
+        G.second[i].Succ = adiacenti(L0, L1) && controlFlowEquivalenti(L0, L1, DT, PDT);
+        Archi += G.second[i].Succ;
       }
-      errs() << "   header1 salta a body1 / end\n";
-
-      // modificare PHI node in header2
-      SmallVector<std::pair<Value *, BasicBlock *>, 4> newIncomingIV2;
-      for (unsigned i = 0; i < IV2->getNumIncomingValues(); ++i) {
-        BasicBlock *BB = IV2->getIncomingBlock(i);
-        Value *V = IV2->getIncomingValue(i);
-        if (llvm::is_contained(predecessors(header2), BB)) {
-          newIncomingIV2.push_back({V, BB});
+    errs() << "Grafo di fusione: " << Archi << " archi\n";
+
+    // Fusione greedy delle catene: il loop fuso resta il primo della catena
+    // e viene confrontato con il successivo; dopo ogni fusione le analisi
+    // sono aggiornate, quindi anche il controllo delle dipendenze vede il
+    // corpo fuso
+    unsigned Fusioni = 0;
+    for (auto &G : Gruppi) {
+      SmallVector<NodoFusione, 8> &Nodi = G.second;
+      Loop *Corrente = Nodi.empty() ? nullptr : Nodi[0].L;
+      for (size_t i = 0; i + 1 < Nodi.size(); i++) {
+        Loop *Prossimo = Nodi[i + 1].L;
+        // Dopo un peeling alla fine i due loop non sono piu' adiacenti
+        int64_t Peel;
+        if (Nodi[i].Succ && adiacenti(Corrente, Prossimo) &&
+            fondibili(Corrente, Prossimo, SE, DT, DI, Peel)) {
+          if (Peel < 0)
+            peelPrima(Corrente, -Peel, LI, SE);
+          else if (Peel > 0)
+            peelDopo(Prossimo, Peel, LI, SE);
+          fondiNido(Corrente, Prossimo, DT, PDT, LI, SE);
+          Fusioni++;
+        } else {
+          Corrente = Prossimo;
         }
       }
-      while (IV2->getNumIncomingValues() > 0)
-        IV2->removeIncomingValue((unsigned)0, false);
-      for (auto &pair : newIncomingIV2)
-        IV2->addIncoming(pair.first, pair.second);
-
-      errs() << "Fusione completata\n";
-
-
-    }  
-
-  	return PreservedAnalyses::all();
+    }
+    errs() << "Fusioni: " << Fusioni << "\n";
+
+    if (!Changed && Fusioni == 0)
+      return PreservedAnalyses::all();
+    PreservedAnalyses PA;
+    PA.preserve<DominatorTreeAnalysis>();
+    PA.preserve<PostDominatorTreeAnalysis>();
+    PA.preserve<LoopAnalysis>();
+    return PA;
   }
 
   // Without isRequired returning true, this pass will be skipped for functions
@@ -0,0 +1,81 @@
+; catena.ll: quattro loop adiacenti con lo stesso trip count e accessi a
+; array diversi. La catena viene fusa in un solo loop.
+@A = global [100 x i32] zeroinitializer
+@B = global [100 x i32] zeroinitializer
+@C = global [100 x i32] zeroinitializer
+@D = global [100 x i32] zeroinitializer
+
+define i32 @catena(i32 %k) {
+entry:
+  br label %h1
+
+h1:
+  %i1 = phi i32 [ 0, %entry ], [ %i1.n, %l1 ]
+  %s = phi i32 [ 0, %entry ], [ %s.n, %l1 ]
+  %c1 = icmp slt i32 %i1, 100
+  br i1 %c1, label %b1, label %e1
+
+b1:
+  %p1 = getelementptr inbounds [100 x i32], ptr @A, i32 0, i32 %i1
+  store i32 %k, ptr %p1
+  %s.n = add i32 %s, %i1
+  br label %l1
+
+l1:
+  %i1.n = add i32 %i1, 1
+  br label %h1
+
+e1:
+  br label %h2
+
+h2:
+  %i2 = phi i32 [ 0, %e1 ], [ %i2.n, %l2 ]
+  %c2 = icmp slt i32 %i2, 100
+  br i1 %c2, label %b2, label %e2
+
+b2:
+  %p2 = getelementptr inbounds [100 x i32], ptr @B, i32 0, i32 %i2
+  store i32 %i2, ptr %p2
+  br label %l2
+
+l2:
+  %i2.n = add i32 %i2, 1
+  br label %h2
+
+e2:
+  br label %h3
+
+h3:
+  %i3 = phi i32 [ 0, %e2 ], [ %i3.n, %l3 ]
+  %c3 = icmp slt i32 %i3, 100
+  br i1 %c3, label %b3, label %e3
+
+b3:
+  %p3 = getelementptr inbounds [100 x i32], ptr @C, i32 0, i32 %i3
+  store i32 1, ptr %p3
+  br label %l3
+
+l3:
+  %i3.n = add i32 %i3, 1
+  br label %h3
+
+e3:
+  br label %h4
+
+h4:
+  %i4 = phi i32 [ 0, %e3 ], [ %i4.n, %l4 ]
+  %c4 = icmp slt i32 %i4, 100
+  br i1 %c4, label %b4, label %e4
+
+b4:
+  %p4 = getelementptr inbounds [100 x i32], ptr @D, i32 0, i32 %i4
+  store i32 2, ptr %p4
+  br label %l4
+
+l4:
+  %i4.n = add i32 %i4, 1
+  br label %h4
+
+e4:
+  ret i32 %s
+}
@@ -0,0 +1,73 @@
+; ModuleID = '../test/catena.ll'
+source_filename = "../test/catena.ll"
+
+@A = global [100 x i32] zeroinitializer
+@B = global [100 x i32] zeroinitializer
+@C = global [100 x i32] zeroinitializer
+@D = global [100 x i32] zeroinitializer
+
+define i32 @catena(i32 %k) {
+entry:
+  br label %h1
+
+h1:                                               ; preds = %l4, %entry
+  %i1 = phi i32 [ 0, %entry ], [ %i1.n, %l4 ]
+  %s = phi i32 [ 0, %entry ], [ %s.n, %l4 ]
+  %i2 = phi i32 [ 0, %entry ], [ %i2.n, %l4 ]
+  %i3 = phi i32 [ 0, %entry ], [ %i3.n, %l4 ]
+  %i4 = phi i32 [ 0, %entry ], [ %i4.n, %l4 ]
+  %c1 = icmp slt i32 %i1, 100
+  br i1 %c1, label %b1, label %e4
+
+b1:                                               ; preds = %h1
+  %p1 = getelementptr inbounds [100 x i32], ptr @A, i32 0, i32 %i1
+  store i32 %k, ptr %p1, align 4
+  %s.n = add i32 %s, %i1
+  br label %l1
+
+l1:                                               ; preds = %b1
+  %i1.n = add i32 %i1, 1
+  br label %h2
+
+h2:                                               ; preds = %l1
+  %c2 = icmp slt i32 %i2, 100
+  br label %b2
+
+b2:                                               ; preds = %h2
+  %p2 = getelementptr inbounds [100 x i32], ptr @B, i32 0, i32 %i2
+  store i32 %i2, ptr %p2, align 4
+  br label %l2
+
+l2:                                               ; preds = %b2
+  %i2.n = add i32 %i2, 1
+  br label %h3
+
+h3:                                               ; preds = %l2
+  %c3 = icmp slt i32 %i3, 100
+  br label %b3
+
+b3:                                               ; preds = %h3
+  %p3 = getelementptr inbounds [100 x i32], ptr @C, i32 0, i32 %i3
+  store i32 1, ptr %p3, align 4
+  br label %l3
+
+l3:                                               ; preds = %b3
+  %i3.n = add i32 %i3, 1
+  br label %h4
+
+h4:                                               ; preds = %l3
+  %c4 = icmp slt i32 %i4, 100
+  br label %b4
+
+b4:                                               ; preds = %h4
+  %p4 = getelementptr inbounds [100 x i32], ptr @D, i32 0, i32 %i4
+  store i32 2, ptr %p4, align 4
+  br label %l4
+
+l4:                                               ; preds = %b4
+  %i4.n = add i32 %i4, 1
+  br label %h1
+
+e4:                                               ; preds = %h1
+  ret i32 %s
+}
@@ -0,0 +1,184 @@
+; dipendenze.ll: il secondo loop legge l'array scritto dal primo.
+; @stessa_iterazione: b[j] = a[j] + 7 legge il valore scritto alla stessa
+; iterazione, i loop vengono fusi.
+; @iterazione_precedente: legge a[j-1], scritto un'iterazione prima. Anche
+; dopo la fusione il valore e' gia' pronto: i loop vengono fusi.
+; @iterazione_successiva: legge a[j+1], che dopo la fusione verrebbe letto
+; prima di essere scritto. Nessuna fusione.
+; @usa_valori: il secondo loop usa la somma calcolata dal primo. Nessuna
+; fusione.
+@a = global [130 x i32] zeroinitializer
+@b = global [130 x i32] zeroinitializer
+
+define void @stessa_iterazione() {
+entry:
+  br label %a.h
+
+a.h:
+  %i = phi i64 [ 1, %entry ], [ %i.n, %a.l ]
+  %c = icmp slt i64 %i, 100
+  br i1 %c, label %a.b, label %a.e
+
+a.b:
+  %p = getelementptr inbounds [130 x i32], ptr @a, i64 0, i64 %i
+  %v = trunc i64 %i to i32
+  store i32 %v, ptr %p
+  br label %a.l
+
+a.l:
+  %i.n = add nsw i64 %i, 1
+  br label %a.h
+
+a.e:
+  br label %b.h
+
+b.h:
+  %j = phi i64 [ 1, %a.e ], [ %j.n, %b.l ]
+  %cj = icmp slt i64 %j, 100
+  br i1 %cj, label %b.b, label %b.e
+
+b.b:
+  %q = getelementptr inbounds [130 x i32], ptr @a, i64 0, i64 %j
+  %x = load i32, ptr %q
+  %w = add i32 %x, 7
+  %r = getelementptr inbounds [130 x i32], ptr @b, i64 0, i64 %j
+  store i32 %w, ptr %r
+  br label %b.l
+
+b.l:
+  %j.n = add nsw i64 %j, 1
+  br label %b.h
+
+b.e:
+  ret void
+}
+
+define void @iterazione_precedente() {
+entry:
+  br label %a.h
+
+a.h:
+  %i = phi i64 [ 1, %entry ], [ %i.n, %a.l ]
+  %c = icmp slt i64 %i, 100
+  br i1 %c, label %a.b, label %a.e
+
+a.b:
+  %p = getelementptr inbounds [130 x i32], ptr @a, i64 0, i64 %i
+  %v = trunc i64 %i to i32
+  store i32 %v, ptr %p
+  br label %a.l
+
+a.l:
+  %i.n = add nsw i64 %i, 1
+  br label %a.h
+
+a.e:
+  br label %b.h
+
+b.h:
+  %j = phi i64 [ 1, %a.e ], [ %j.n, %b.l ]
+  %cj = icmp slt i64 %j, 100
+  br i1 %cj, label %b.b, label %b.e
+
+b.b:
+  %jo = add nsw i64 %j, -1
+  %q = getelementptr inbounds [130 x i32], ptr @a, i64 0, i64 %jo
+  %x = load i32, ptr %q
+  %w = add i32 %x, 7
+  %r = getelementptr inbounds [130 x i32], ptr @b, i64 0, i64 %j
+  store i32 %w, ptr %r
+  br label %b.l
+
+b.l:
+  %j.n = add nsw i64 %j, 1
+  br label %b.h
+
+b.e:
+  ret void
+}
+
+define void @iterazione_successiva() {
+entry:
+  br label %a.h
+
+a.h:
+  %i = phi i64 [ 1, %entry ], [ %i.n, %a.l ]
+  %c = icmp slt i64 %i, 100
+  br i1 %c, label %a.b, label %a.e
+
+a.b:
+  %p = getelementptr inbounds [130 x i32], ptr @a, i64 0, i64 %i
+  %v = trunc i64 %i to i32
+  store i32 %v, ptr %p
+  br label %a.l
+
+a.l:
+  %i.n = add nsw i64 %i, 1
+  br label %a.h
+
+a.e:
+  br label %b.h
+
+b.h:
+  %j = phi i64 [ 1, %a.e ], [ %j.n, %b.l ]
+  %cj = icmp slt i64 %j, 100
+  br i1 %cj, label %b.b, label %b.e
+
+b.b:
+  %jo = add nsw i64 %j, 1
+  %q = getelementptr inbounds [130 x i32], ptr @a, i64 0, i64 %jo
+  %x = load i32, ptr %q
+  %w = add i32 %x, 7
+  %r = getelementptr inbounds [130 x i32], ptr @b, i64 0, i64 %j
+  store i32 %w, ptr %r
+  br label %b.l
+
+b.l:
+  %j.n = add nsw i64 %j, 1
+  br label %b.h
+
+b.e:
+  ret void
+}
+
+define void @usa_valori() {
+entry:
+  br label %a.h
+
+a.h:
+  %i = phi i64 [ 1, %entry ], [ %i.n, %a.l ]
+  %s = phi i32 [ 0, %entry ], [ %s.n, %a.l ]
+  %c = icmp slt i64 %i, 100
+  br i1 %c, label %a.b, label %a.e
+
+a.b:
+  %p = getelementptr inbounds [130 x i32], ptr @a, i64 0, i64 %i
+  %v = trunc i64 %i to i32
+  store i32 %v, ptr %p
+  %s.n = add i32 %s, %v
+  br label %a.l
+
+a.l:
+  %i.n = add nsw i64 %i, 1
+  br label %a.h
+
+a.e:
+  br label %b.h
+
+b.h:
+  %j = phi i64 [ 1, %a.e ], [ %j.n, %b.l ]
+  %cj = icmp slt i64 %j, 100
+  br i1 %cj, label %b.b, label %b.e
+
+b.b:
+  %r = getelementptr inbounds [130 x i32], ptr @b, i64 0, i64 %j
+  store i32 %s, ptr %r
+  br label %b.l
+
+b.l:
+  %j.n = add nsw i64 %j, 1
+  br label %b.h
+
+b.e:
+  ret void
+}
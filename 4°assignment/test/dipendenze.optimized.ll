@@ -0,0 +1,172 @@
+; ModuleID = '../test/dipendenze.ll'
+source_filename = "../test/dipendenze.ll"
+
+@a = global [130 x i32] zeroinitializer
+@b = global [130 x i32] zeroinitializer
+
+define void @stessa_iterazione() {
+entry:
+  br label %a.h
+
+a.h:                                              ; preds = %b.l, %entry
+  %i = phi i64 [ 1, %entry ], [ %i.n, %b.l ]
+  %j = phi i64 [ 1, %entry ], [ %j.n, %b.l ]
+  %c = icmp slt i64 %i, 100
+  br i1 %c, label %a.b, label %b.e
+
+a.b:                                              ; preds = %a.h
+  %p = getelementptr inbounds [130 x i32], ptr @a, i64 0, i64 %i
+  %v = trunc i64 %i to i32
+  store i32 %v, ptr %p, align 4
+  br label %a.l
+
+a.l:                                              ; preds = %a.b
+  %i.n = add nsw i64 %i, 1
+  br label %b.h
+
+b.h:                                              ; preds = %a.l
+  %cj = icmp slt i64 %j, 100
+  br label %b.b
+
+b.b:                                              ; preds = %b.h
+  %q = getelementptr inbounds [130 x i32], ptr @a, i64 0, i64 %j
+  %x = load i32, ptr %q, align 4
+  %w = add i32 %x, 7
+  %r = getelementptr inbounds [130 x i32], ptr @b, i64 0, i64 %j
+  store i32 %w, ptr %r, align 4
+  br label %b.l
+
+b.l:                                              ; preds = %b.b
+  %j.n = add nsw i64 %j, 1
+  br label %a.h
+
+b.e:                                              ; preds = %a.h
+  ret void
+}
+
+define void @iterazione_precedente() {
+entry:
+  br label %a.h
+
+a.h:                                              ; preds = %b.l, %entry
+  %i = phi i64 [ 1, %entry ], [ %i.n, %b.l ]
+  %j = phi i64 [ 1, %entry ], [ %j.n, %b.l ]
+  %c = icmp slt i64 %i, 100
+  br i1 %c, label %a.b, label %b.e
+
+a.b:                                              ; preds = %a.h
+  %p = getelementptr inbounds [130 x i32], ptr @a, i64 0, i64 %i
+  %v = trunc i64 %i to i32
+  store i32 %v, ptr %p, align 4
+  br label %a.l
+
+a.l:                                              ; preds = %a.b
+  %i.n = add nsw i64 %i, 1
+  br label %b.h
+
+b.h:                                              ; preds = %a.l
+  %cj = icmp slt i64 %j, 100
+  br label %b.b
+
+b.b:                                              ; preds = %b.h
+  %jo = add nsw i64 %j, -1
+  %q = getelementptr inbounds [130 x i32], ptr @a, i64 0, i64 %jo
+  %x = load i32, ptr %q, align 4
+  %w = add i32 %x, 7
+  %r = getelementptr inbounds [130 x i32], ptr @b, i64 0, i64 %j
+  store i32 %w, ptr %r, align 4
+  br label %b.l
+
+b.l:                                              ; preds = %b.b
+  %j.n = add nsw i64 %j, 1
+  br label %a.h
+
+b.e:                                              ; preds = %a.h
+  ret void
+}
+
+define void @iterazione_successiva() {
+entry:
+  br label %a.h
+
+a.h:                                              ; preds = %a.l, %entry
+  %i = phi i64 [ 1, %entry ], [ %i.n, %a.l ]
+  %c = icmp slt i64 %i, 100
+  br i1 %c, label %a.b, label %a.e
+
+a.b:                                              ; preds = %a.h
+  %p = getelementptr inbounds [130 x i32], ptr @a, i64 0, i64 %i
+  %v = trunc i64 %i to i32
+  store i32 %v, ptr %p, align 4
+  br label %a.l
+
+a.l:                                              ; preds = %a.b
+  %i.n = add nsw i64 %i, 1
+  br label %a.h
+
+a.e:                                              ; preds = %a.h
+  br label %b.h
+
+b.h:                                              ; preds = %b.l, %a.e
+  %j = phi i64 [ 1, %a.e ], [ %j.n, %b.l ]
+  %cj = icmp slt i64 %j, 100
+  br i1 %cj, label %b.b, label %b.e
+
+b.b:                                              ; preds = %b.h
+  %jo = add nsw i64 %j, 1
+  %q = getelementptr inbounds [130 x i32], ptr @a, i64 0, i64 %jo
+  %x = load i32, ptr %q, align 4
+  %w = add i32 %x, 7
+  %r = getelementptr inbounds [130 x i32], ptr @b, i64 0, i64 %j
+  store i32 %w, ptr %r, align 4
+  br label %b.l
+
+b.l:                                              ; preds = %b.b
+  %j.n = add nsw i64 %j, 1
+  br label %b.h
+
+b.e:                                              ; preds = %b.h
+  ret void
+}
+
+define void @usa_valori() {
+entry:
+  br label %a.h
+
+a.h:                                              ; preds = %a.l, %entry
+  %i = phi i64 [ 1, %entry ], [ %i.n, %a.l ]
+  %s = phi i32 [ 0, %entry ], [ %s.n, %a.l ]
+  %c = icmp slt i64 %i, 100
+  br i1 %c, label %a.b, label %a.e
+
+a.b:                                              ; preds = %a.h
+  %p = getelementptr inbounds [130 x i32], ptr @a, i64 0, i64 %i
+  %v = trunc i64 %i to i32
+  store i32 %v, ptr %p, align 4
+  %s.n = add i32 %s, %v
+  br label %a.l
+
+a.l:                                              ; preds = %a.b
+  %i.n = add nsw i64 %i, 1
+  br label %a.h
+
+a.e:                                              ; preds = %a.h
+  br label %b.h
+
+b.h:                                              ; preds = %b.l, %a.e
+  %j = phi i64 [ 1, %a.e ], [ %j.n, %b.l ]
+  %cj = icmp slt i64 %j, 100
+  br i1 %cj, label %b.b, label %b.e
+
+b.b:                                              ; preds = %b.h
+  %r = getelementptr inbounds [130 x i32], ptr @b, i64 0, i64 %j
+  store i32 %s, ptr %r, align 4
+  br label %b.l
+
+b.l:                                              ; preds = %b.b
+  %j.n = add nsw i64 %j, 1
+  br label %b.h
+
+b.e:                                              ; preds = %b.h
+  ret void
+}
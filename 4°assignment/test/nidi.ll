@@ -0,0 +1,227 @@
+; nidi.ll: nidi di loop perfetti.
+; @nidi: B[i][j] legge A[i][j], scritto alla stessa iterazione del primo
+; nido. I due nidi vengono fusi, sia i loop esterni che quelli interni.
+; @trasposti: B[i][j] legge A[j][i], scritto dal primo nido in
+; un'iterazione successiva. Nessuna fusione.
+; @profondita_diverse: un nido seguito da un loop semplice. Nessuna fusione.
+@A = global [64 x [64 x i32]] zeroinitializer
+@B = global [64 x [64 x i32]] zeroinitializer
+@C = global [64 x i32] zeroinitializer
+
+define void @nidi(i32 %k) {
+entry:
+  br label %a.oh
+
+a.oh:
+  %ai = phi i32 [ 0, %entry ], [ %ai.n, %a.ol ]
+  %ac = icmp slt i32 %ai, 64
+  br i1 %ac, label %a.ob, label %a.oe
+
+a.ob:
+  br label %a.ih
+
+a.ih:
+  %aj = phi i32 [ 0, %a.ob ], [ %aj.n, %a.il ]
+  %acj = icmp slt i32 %aj, 64
+  br i1 %acj, label %a.ib, label %a.ie
+
+a.ib:
+  %aie = sext i32 %ai to i64
+  %aje = sext i32 %aj to i64
+  %ap = getelementptr inbounds [64 x [64 x i32]], ptr @A, i64 0, i64 %aie, i64 %aje
+  %av = add i32 %k, %ai
+  store i32 %av, ptr %ap
+  br label %a.il
+
+a.il:
+  %aj.n = add nsw i32 %aj, 1
+  br label %a.ih
+
+a.ie:
+  br label %a.ol
+
+a.ol:
+  %ai.n = add nsw i32 %ai, 1
+  br label %a.oh
+
+a.oe:
+  br label %b.oh
+
+b.oh:
+  %bi = phi i32 [ 0, %a.oe ], [ %bi.n, %b.ol ]
+  %bc = icmp slt i32 %bi, 64
+  br i1 %bc, label %b.ob, label %b.oe
+
+b.ob:
+  br label %b.ih
+
+b.ih:
+  %bj = phi i32 [ 0, %b.ob ], [ %bj.n, %b.il ]
+  %bcj = icmp slt i32 %bj, 64
+  br i1 %bcj, label %b.ib, label %b.ie
+
+b.ib:
+  %bie = sext i32 %bi to i64
+  %bje = sext i32 %bj to i64
+  %bp = getelementptr inbounds [64 x [64 x i32]], ptr @B, i64 0, i64 %bie, i64 %bje
+  %bq = getelementptr inbounds [64 x [64 x i32]], ptr @A, i64 0, i64 %bie, i64 %bje
+  %bx = load i32, ptr %bq
+  %bv = add i32 %bx, %bj
+  store i32 %bv, ptr %bp
+  br label %b.il
+
+b.il:
+  %bj.n = add nsw i32 %bj, 1
+  br label %b.ih
+
+b.ie:
+  br label %b.ol
+
+b.ol:
+  %bi.n = add nsw i32 %bi, 1
+  br label %b.oh
+
+b.oe:
+  br label %end
+
+end:
+  ret void
+}
+
+define void @trasposti(i32 %k) {
+entry:
+  br label %a.oh
+
+a.oh:
+  %ai = phi i32 [ 0, %entry ], [ %ai.n, %a.ol ]
+  %ac = icmp slt i32 %ai, 64
+  br i1 %ac, label %a.ob, label %a.oe
+
+a.ob:
+  br label %a.ih
+
+a.ih:
+  %aj = phi i32 [ 0, %a.ob ], [ %aj.n, %a.il ]
+  %acj = icmp slt i32 %aj, 64
+  br i1 %acj, label %a.ib, label %a.ie
+
+a.ib:
+  %aie = sext i32 %ai to i64
+  %aje = sext i32 %aj to i64
+  %ap = getelementptr inbounds [64 x [64 x i32]], ptr @A, i64 0, i64 %aie, i64 %aje
+  %av = add i32 %k, %ai
+  store i32 %av, ptr %ap
+  br label %a.il
+
+a.il:
+  %aj.n = add nsw i32 %aj, 1
+  br label %a.ih
+
+a.ie:
+  br label %a.ol
+
+a.ol:
+  %ai.n = add nsw i32 %ai, 1
+  br label %a.oh
+
+a.oe:
+  br label %b.oh
+
+b.oh:
+  %bi = phi i32 [ 0, %a.oe ], [ %bi.n, %b.ol ]
+  %bc = icmp slt i32 %bi, 64
+  br i1 %bc, label %b.ob, label %b.oe
+
+b.ob:
+  br label %b.ih
+
+b.ih:
+  %bj = phi i32 [ 0, %b.ob ], [ %bj.n, %b.il ]
+  %bcj = icmp slt i32 %bj, 64
+  br i1 %bcj, label %b.ib, label %b.ie
+
+b.ib:
+  %bie = sext i32 %bi to i64
+  %bje = sext i32 %bj to i64
+  %bp = getelementptr inbounds [64 x [64 x i32]], ptr @B, i64 0, i64 %bie, i64 %bje
+  %bq = getelementptr inbounds [64 x [64 x i32]], ptr @A, i64 0, i64 %bje, i64 %bie
+  %bx = load i32, ptr %bq
+  %bv = add i32 %bx, %bj
+  store i32 %bv, ptr %bp
+  br label %b.il
+
+b.il:
+  %bj.n = add nsw i32 %bj, 1
+  br label %b.ih
+
+b.ie:
+  br label %b.ol
+
+b.ol:
+  %bi.n = add nsw i32 %bi, 1
+  br label %b.oh
+
+b.oe:
+  br label %end
+
+end:
+  ret void
+}
+
+define void @profondita_diverse(i32 %k) {
+entry:
+  br label %a.oh
+
+a.oh:
+  %ai = phi i32 [ 0, %entry ], [ %ai.n, %a.ol ]
+  %ac = icmp slt i32 %ai, 64
+  br i1 %ac, label %a.ob, label %a.oe
+
+a.ob:
+  br label %a.ih
+
+a.ih:
+  %aj = phi i32 [ 0, %a.ob ], [ %aj.n, %a.il ]
+  %acj = icmp slt i32 %aj, 64
+  br i1 %acj, label %a.ib, label %a.ie
+
+a.ib:
+  %aie = sext i32 %ai to i64
+  %aje = sext i32 %aj to i64
+  %ap = getelementptr inbounds [64 x [64 x i32]], ptr @A, i64 0, i64 %aie, i64 %aje
+  %av = add i32 %k, %ai
+  store i32 %av, ptr %ap
+  br label %a.il
+
+a.il:
+  %aj.n = add nsw i32 %aj, 1
+  br label %a.ih
+
+a.ie:
+  br label %a.ol
+
+a.ol:
+  %ai.n = add nsw i32 %ai, 1
+  br label %a.oh
+
+a.oe:
+  br label %c.h
+
+c.h:
+  %ci = phi i32 [ 0, %a.oe ], [ %ci.n, %c.l ]
+  %cc = icmp slt i32 %ci, 64
+  br i1 %cc, label %c.b, label %end
+
+c.b:
+  %cie = sext i32 %ci to i64
+  %cp = getelementptr inbounds [64 x i32], ptr @C, i64 0, i64 %cie
+  store i32 %ci, ptr %cp
+  br label %c.l
+
+c.l:
+  %ci.n = add nsw i32 %ci, 1
+  br label %c.h
+
+end:
+  ret void
+}
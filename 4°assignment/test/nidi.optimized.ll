@@ -0,0 +1,209 @@
+; ModuleID = '../test/nidi.ll'
+source_filename = "../test/nidi.ll"
+
+@A = global [64 x [64 x i32]] zeroinitializer
+@B = global [64 x [64 x i32]] zeroinitializer
+@C = global [64 x i32] zeroinitializer
+
+define void @nidi(i32 %k) {
+entry:
+  br label %a.oh
+
+a.oh:                                             ; preds = %b.ol, %entry
+  %ai = phi i32 [ 0, %entry ], [ %ai.n, %b.ol ]
+  %bi = phi i32 [ 0, %entry ], [ %bi.n, %b.ol ]
+  %ac = icmp slt i32 %ai, 64
+  br i1 %ac, label %a.ob, label %b.oe
+
+a.ob:                                             ; preds = %a.oh
+  %ai.n = add nsw i32 %ai, 1
+  %bc = icmp slt i32 %bi, 64
+  br label %a.ih
+
+a.ih:                                             ; preds = %b.il, %a.ob
+  %aj = phi i32 [ 0, %a.ob ], [ %aj.n, %b.il ]
+  %bj = phi i32 [ 0, %a.ob ], [ %bj.n, %b.il ]
+  %acj = icmp slt i32 %aj, 64
+  br i1 %acj, label %a.ib, label %b.ie
+
+a.ib:                                             ; preds = %a.ih
+  %aie = sext i32 %ai to i64
+  %aje = sext i32 %aj to i64
+  %ap = getelementptr inbounds [64 x [64 x i32]], ptr @A, i64 0, i64 %aie, i64 %aje
+  %av = add i32 %k, %ai
+  store i32 %av, ptr %ap, align 4
+  br label %a.il
+
+a.il:                                             ; preds = %a.ib
+  %aj.n = add nsw i32 %aj, 1
+  br label %b.ih
+
+b.ih:                                             ; preds = %a.il
+  %bcj = icmp slt i32 %bj, 64
+  br label %b.ib
+
+b.ib:                                             ; preds = %b.ih
+  %bie = sext i32 %bi to i64
+  %bje = sext i32 %bj to i64
+  %bp = getelementptr inbounds [64 x [64 x i32]], ptr @B, i64 0, i64 %bie, i64 %bje
+  %bq = getelementptr inbounds [64 x [64 x i32]], ptr @A, i64 0, i64 %bie, i64 %bje
+  %bx = load i32, ptr %bq, align 4
+  %bv = add i32 %bx, %bj
+  store i32 %bv, ptr %bp, align 4
+  br label %b.il
+
+b.il:                                             ; preds = %b.ib
+  %bj.n = add nsw i32 %bj, 1
+  br label %a.ih
+
+b.ie:                                             ; preds = %a.ih
+  br label %b.ol
+
+b.ol:                                             ; preds = %b.ie
+  %bi.n = add nsw i32 %bi, 1
+  br label %a.oh
+
+b.oe:                                             ; preds = %a.oh
+  br label %end
+
+end:                                              ; preds = %b.oe
+  ret void
+}
+
+define void @trasposti(i32 %k) {
+entry:
+  br label %a.oh
+
+a.oh:                                             ; preds = %a.ol, %entry
+  %ai = phi i32 [ 0, %entry ], [ %ai.n, %a.ol ]
+  %ac = icmp slt i32 %ai, 64
+  br i1 %ac, label %a.ob, label %a.oe
+
+a.ob:                                             ; preds = %a.oh
+  br label %a.ih
+
+a.ih:                                             ; preds = %a.il, %a.ob
+  %aj = phi i32 [ 0, %a.ob ], [ %aj.n, %a.il ]
+  %acj = icmp slt i32 %aj, 64
+  br i1 %acj, label %a.ib, label %a.ie
+
+a.ib:                                             ; preds = %a.ih
+  %aie = sext i32 %ai to i64
+  %aje = sext i32 %aj to i64
+  %ap = getelementptr inbounds [64 x [64 x i32]], ptr @A, i64 0, i64 %aie, i64 %aje
+  %av = add i32 %k, %ai
+  store i32 %av, ptr %ap, align 4
+  br label %a.il
+
+a.il:                                             ; preds = %a.ib
+  %aj.n = add nsw i32 %aj, 1
+  br label %a.ih
+
+a.ie:                                             ; preds = %a.ih
+  br label %a.ol
+
+a.ol:                                             ; preds = %a.ie
+  %ai.n = add nsw i32 %ai, 1
+  br label %a.oh
+
+a.oe:                                             ; preds = %a.oh
+  br label %b.oh
+
+b.oh:                                             ; preds = %b.ol, %a.oe
+  %bi = phi i32 [ 0, %a.oe ], [ %bi.n, %b.ol ]
+  %bc = icmp slt i32 %bi, 64
+  br i1 %bc, label %b.ob, label %b.oe
+
+b.ob:                                             ; preds = %b.oh
+  br label %b.ih
+
+b.ih:                                             ; preds = %b.il, %b.ob
+  %bj = phi i32 [ 0, %b.ob ], [ %bj.n, %b.il ]
+  %bcj = icmp slt i32 %bj, 64
+  br i1 %bcj, label %b.ib, label %b.ie
+
+b.ib:                                             ; preds = %b.ih
+  %bie = sext i32 %bi to i64
+  %bje = sext i32 %bj to i64
+  %bp = getelementptr inbounds [64 x [64 x i32]], ptr @B, i64 0, i64 %bie, i64 %bje
+  %bq = getelementptr inbounds [64 x [64 x i32]], ptr @A, i64 0, i64 %bje, i64 %bie
+  %bx = load i32, ptr %bq, align 4
+  %bv = add i32 %bx, %bj
+  store i32 %bv, ptr %bp, align 4
+  br label %b.il
+
+b.il:                                             ; preds = %b.ib
+  %bj.n = add nsw i32 %bj, 1
+  br label %b.ih
+
+b.ie:                                             ; preds = %b.ih
+  br label %b.ol
+
+b.ol:                                             ; preds = %b.ie
+  %bi.n = add nsw i32 %bi, 1
+  br label %b.oh
+
+b.oe:                                             ; preds = %b.oh
+  br label %end
+
+end:                                              ; preds = %b.oe
+  ret void
+}
+
+define void @profondita_diverse(i32 %k) {
+entry:
+  br label %a.oh
+
+a.oh:                                             ; preds = %a.ol, %entry
+  %ai = phi i32 [ 0, %entry ], [ %ai.n, %a.ol ]
+  %ac = icmp slt i32 %ai, 64
+  br i1 %ac, label %a.ob, label %a.oe
+
+a.ob:                                             ; preds = %a.oh
+  br label %a.ih
+
+a.ih:                                             ; preds = %a.il, %a.ob
+  %aj = phi i32 [ 0, %a.ob ], [ %aj.n, %a.il ]
+  %acj = icmp slt i32 %aj, 64
+  br i1 %acj, label %a.ib, label %a.ie
+
+a.ib:                                             ; preds = %a.ih
+  %aie = sext i32 %ai to i64
+  %aje = sext i32 %aj to i64
+  %ap = getelementptr inbounds [64 x [64 x i32]], ptr @A, i64 0, i64 %aie, i64 %aje
+  %av = add i32 %k, %ai
+  store i32 %av, ptr %ap, align 4
+  br label %a.il
+
+a.il:                                             ; preds = %a.ib
+  %aj.n = add nsw i32 %aj, 1
+  br label %a.ih
+
+a.ie:                                             ; preds = %a.ih
+  br label %a.ol
+
+a.ol:                                             ; preds = %a.ie
+  %ai.n = add nsw i32 %ai, 1
+  br label %a.oh
+
+a.oe:                                             ; preds = %a.oh
+  br label %c.h
+
+c.h:                                              ; preds = %c.l, %a.oe
+  %ci = phi i32 [ 0, %a.oe ], [ %ci.n, %c.l ]
+  %cc = icmp slt i32 %ci, 64
+  br i1 %cc, label %c.b, label %end
+
+c.b:                                              ; preds = %c.h
+  %cie = sext i32 %ci to i64
+  %cp = getelementptr inbounds [64 x i32], ptr @C, i64 0, i64 %cie
+  store i32 %ci, ptr %cp, align 4
+  br label %c.l
+
+c.l:                                              ; preds = %c.b
+  %ci.n = add nsw i32 %ci, 1
+  br label %c.h
+
+end:                                              ; preds = %c.h
+  ret void
+}
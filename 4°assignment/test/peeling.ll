@@ -0,0 +1,93 @@
+; peeling.ll: trip count costanti diversi.
+; @peel: 100 e 98 iterazioni, le prime 2 iterazioni del primo loop vengono
+; copiate prima del loop (peeling) e il resto viene fuso.
+; @troppe: 100 e 60 iterazioni, la differenza supera -fusion-max-peel
+; (default 8) e i loop restano separati.
+@a = global [128 x i32] zeroinitializer
+@b = global [128 x i32] zeroinitializer
+
+define void @peel() {
+entry:
+  br label %a.h
+
+a.h:
+  %i = phi i32 [ 0, %entry ], [ %i.n, %a.l ]
+  %c = icmp slt i32 %i, 100
+  br i1 %c, label %a.b, label %a.e
+
+a.b:
+  %ie = sext i32 %i to i64
+  %p = getelementptr inbounds [128 x i32], ptr @a, i64 0, i64 %ie
+  %v = mul i32 %i, 3
+  store i32 %v, ptr %p
+  br label %a.l
+
+a.l:
+  %i.n = add nsw i32 %i, 1
+  br label %a.h
+
+a.e:
+  br label %b.h
+
+b.h:
+  %j = phi i32 [ 0, %a.e ], [ %j.n, %b.l ]
+  %cj = icmp slt i32 %j, 98
+  br i1 %cj, label %b.b, label %b.e
+
+b.b:
+  %je = sext i32 %j to i64
+  %q = getelementptr inbounds [128 x i32], ptr @b, i64 0, i64 %je
+  %w = add i32 %j, 7
+  store i32 %w, ptr %q
+  br label %b.l
+
+b.l:
+  %j.n = add nsw i32 %j, 1
+  br label %b.h
+
+b.e:
+  ret void
+}
+
+define void @troppe() {
+entry:
+  br label %a.h
+
+a.h:
+  %i = phi i32 [ 0, %entry ], [ %i.n, %a.l ]
+  %c = icmp slt i32 %i, 100
+  br i1 %c, label %a.b, label %a.e
+
+a.b:
+  %ie = sext i32 %i to i64
+  %p = getelementptr inbounds [128 x i32], ptr @a, i64 0, i64 %ie
+  %v = mul i32 %i, 3
+  store i32 %v, ptr %p
+  br label %a.l
+
+a.l:
+  %i.n = add nsw i32 %i, 1
+  br label %a.h
+
+a.e:
+  br label %b.h
+
+b.h:
+  %j = phi i32 [ 0, %a.e ], [ %j.n, %b.l ]
+  %cj = icmp slt i32 %j, 60
+  br i1 %cj, label %b.b, label %b.e
+
+b.b:
+  %je = sext i32 %j to i64
+  %q = getelementptr inbounds [128 x i32], ptr @b, i64 0, i64 %je
+  %w = add i32 %j, 7
+  store i32 %w, ptr %q
+  br label %b.l
+
+b.l:
+  %j.n = add nsw i32 %j, 1
+  br label %b.h
+
+b.e:
+  ret void
+}
@@ -0,0 +1,118 @@
+; ModuleID = '../test/peeling.ll'
+source_filename = "../test/peeling.ll"
+
+@a = global [128 x i32] zeroinitializer
+@b = global [128 x i32] zeroinitializer
+
+define void @peel() {
+entry:
+  br label %a.h.peel
+
+a.h.peel:                                         ; preds = %entry
+  %c.peel = icmp slt i32 0, 100
+  br label %a.b.peel
+
+a.b.peel:                                         ; preds = %a.h.peel
+  %ie.peel = sext i32 0 to i64
+  %p.peel = getelementptr inbounds [128 x i32], ptr @a, i64 0, i64 %ie.peel
+  %v.peel = mul i32 0, 3
+  store i32 %v.peel, ptr %p.peel, align 4
+  br label %a.l.peel
+
+a.l.peel:                                         ; preds = %a.b.peel
+  %i.n.peel = add nsw i32 0, 1
+  br label %a.h.peel1
+
+a.h.peel1:                                        ; preds = %a.l.peel
+  %c.peel2 = icmp slt i32 %i.n.peel, 100
+  br label %a.b.peel3
+
+a.b.peel3:                                        ; preds = %a.h.peel1
+  %ie.peel4 = sext i32 %i.n.peel to i64
+  %p.peel5 = getelementptr inbounds [128 x i32], ptr @a, i64 0, i64 %ie.peel4
+  %v.peel6 = mul i32 %i.n.peel, 3
+  store i32 %v.peel6, ptr %p.peel5, align 4
+  br label %a.l.peel7
+
+a.l.peel7:                                        ; preds = %a.b.peel3
+  %i.n.peel8 = add nsw i32 %i.n.peel, 1
+  br label %a.h
+
+a.h:                                              ; preds = %b.l, %a.l.peel7
+  %i = phi i32 [ %i.n.peel8, %a.l.peel7 ], [ %i.n, %b.l ]
+  %j = phi i32 [ 0, %a.l.peel7 ], [ %j.n, %b.l ]
+  %c = icmp slt i32 %i, 100
+  br i1 %c, label %a.b, label %b.e
+
+a.b:                                              ; preds = %a.h
+  %ie = sext i32 %i to i64
+  %p = getelementptr inbounds [128 x i32], ptr @a, i64 0, i64 %ie
+  %v = mul i32 %i, 3
+  store i32 %v, ptr %p, align 4
+  br label %a.l
+
+a.l:                                              ; preds = %a.b
+  %i.n = add nsw i32 %i, 1
+  br label %b.h
+
+b.h:                                              ; preds = %a.l
+  %cj = icmp slt i32 %j, 98
+  br label %b.b
+
+b.b:                                              ; preds = %b.h
+  %je = sext i32 %j to i64
+  %q = getelementptr inbounds [128 x i32], ptr @b, i64 0, i64 %je
+  %w = add i32 %j, 7
+  store i32 %w, ptr %q, align 4
+  br label %b.l
+
+b.l:                                              ; preds = %b.b
+  %j.n = add nsw i32 %j, 1
+  br label %a.h
+
+b.e:                                              ; preds = %a.h
+  ret void
+}
+
+define void @troppe() {
+entry:
+  br label %a.h
+
+a.h:                                              ; preds = %a.l, %entry
+  %i = phi i32 [ 0, %entry ], [ %i.n, %a.l ]
+  %c = icmp slt i32 %i, 100
+  br i1 %c, label %a.b, label %a.e
+
+a.b:                                              ; preds = %a.h
+  %ie = sext i32 %i to i64
+  %p = getelementptr inbounds [128 x i32], ptr @a, i64 0, i64 %ie
+  %v = mul i32 %i, 3
+  store i32 %v, ptr %p, align 4
+  br label %a.l
+
+a.l:                                              ; preds = %a.b
+  %i.n = add nsw i32 %i, 1
+  br label %a.h
+
+a.e:                                              ; preds = %a.h
+  br label %b.h
+
+b.h:                                              ; preds = %b.l, %a.e
+  %j = phi i32 [ 0, %a.e ], [ %j.n, %b.l ]
+  %cj = icmp slt i32 %j, 60
+  br i1 %cj, label %b.b, label %b.e
+
+b.b:                                              ; preds = %b.h
+  %je = sext i32 %j to i64
+  %q = getelementptr inbounds [128 x i32], ptr @b, i64 0, i64 %je
+  %w = add i32 %j, 7
+  store i32 %w, ptr %q, align 4
+  br label %b.l
+
+b.l:                                              ; preds = %b.b
+  %j.n = add nsw i32 %j, 1
+  br label %b.h
+
+b.e:                                              ; preds = %b.h
+  ret void
+}
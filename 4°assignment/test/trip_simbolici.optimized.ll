@@ -0,0 +1,80 @@
+; ModuleID = '../test/trip_simbolici.ll'
+source_filename = "../test/trip_simbolici.ll"
+
+@A = global [100 x i32] zeroinitializer
+@B = global [100 x i32] zeroinitializer
+
+define void @stesso_n(i32 %n) {
+entry:
+  br label %h1
+
+h1:                                               ; preds = %l2, %entry
+  %i = phi i32 [ 0, %entry ], [ %i.n, %l2 ]
+  %j = phi i32 [ 0, %entry ], [ %j.n, %l2 ]
+  %c1 = icmp slt i32 %i, %n
+  br i1 %c1, label %b1, label %e2
+
+b1:                                               ; preds = %h1
+  %p1 = getelementptr inbounds [100 x i32], ptr @A, i32 0, i32 %i
+  store i32 %i, ptr %p1, align 4
+  br label %l1
+
+l1:                                               ; preds = %b1
+  %i.n = add nsw i32 %i, 1
+  br label %h2
+
+h2:                                               ; preds = %l1
+  %c2 = icmp slt i32 %j, %n
+  br label %b2
+
+b2:                                               ; preds = %h2
+  %p2 = getelementptr inbounds [100 x i32], ptr @B, i32 0, i32 %j
+  store i32 %j, ptr %p2, align 4
+  br label %l2
+
+l2:                                               ; preds = %b2
+  %j.n = add nsw i32 %j, 1
+  br label %h1
+
+e2:                                               ; preds = %h1
+  ret void
+}
+
+define void @n_diversi(i32 %n, i32 %m) {
+entry:
+  br label %h1
+
+h1:                                               ; preds = %l1, %entry
+  %i = phi i32 [ 0, %entry ], [ %i.n, %l1 ]
+  %c1 = icmp slt i32 %i, %n
+  br i1 %c1, label %b1, label %e1
+
+b1:                                               ; preds = %h1
+  %p1 = getelementptr inbounds [100 x i32], ptr @A, i32 0, i32 %i
+  store i32 %i, ptr %p1, align 4
+  br label %l1
+
+l1:                                               ; preds = %b1
+  %i.n = add nsw i32 %i, 1
+  br label %h1
+
+e1:                                               ; preds = %h1
+  br label %h2
+
+h2:                                               ; preds = %l2, %e1
+  %j = phi i32 [ 0, %e1 ], [ %j.n, %l2 ]
+  %c2 = icmp slt i32 %j, %m
+  br i1 %c2, label %b2, label %e2
+
+b2:                                               ; preds = %h2
+  %p2 = getelementptr inbounds [100 x i32], ptr @B, i32 0, i32 %j
+  store i32 %j, ptr %p2, align 4
+  br label %l2
+
+l2:                                               ; preds = %b2
+  %j.n = add nsw i32 %j, 1
+  br label %h2
+
+e2:                                               ; preds = %h2
+  ret void
+}